@@ -0,0 +1,16 @@
+#!/bin/bash
+
+# Usage: ./run-benchmarks.sh [baseline.json]
+# Release build is benchmarked. Results are written to benchmarks.json of the
+# build directory and compared with baseline if it is given
+
+set -e
+
+source setup-dirs.sh release
+(
+    cd $build_dir && make run-benchmarks
+)
+if [ -n "$1" ];
+then
+    src/benchmarks/compare-benchmarks.py "$1" "$build_dir/benchmarks/benchmarks.json"
+fi
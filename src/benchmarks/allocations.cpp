@@ -0,0 +1,14 @@
+#include "allocations.hpp"
+
+using namespace cicbench;
+
+AllocationsCounter::AllocationsCounter(benchmark::State& state) :
+		m_state(state), m_start(allocationsCount())
+{
+}
+
+AllocationsCounter::~AllocationsCounter()
+{
+	m_state.counters["allocs/op"] = benchmark::Counter(
+			static_cast<double>(allocationsCount() - m_start), benchmark::Counter::kAvgIterations);
+}
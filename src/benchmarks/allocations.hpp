@@ -0,0 +1,35 @@
+/*
+ * allocations.hpp
+ *
+ * Heap allocations counting for benchmarks, see counting-allocator.hpp
+ */
+
+#ifndef CIC_BENCH_ALLOCATIONS_HPP_
+#define CIC_BENCH_ALLOCATIONS_HPP_
+
+#include "counting-allocator.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+namespace cicbench {
+
+/**
+ * Counts allocations made while benchmark loop is running. Create it right
+ * before the loop; destructor sets "allocs/op" counter of the benchmark
+ */
+class AllocationsCounter
+{
+public:
+	explicit AllocationsCounter(benchmark::State& state);
+	~AllocationsCounter();
+
+private:
+	benchmark::State& m_state;
+	uint64_t m_start;
+};
+
+} // namespace cicbench
+
+#endif /* CIC_BENCH_ALLOCATIONS_HPP_ */
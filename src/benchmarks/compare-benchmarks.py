@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""
+Compare two JSON outputs of cic-bench and fail if current results regress.
+
+Usage: compare-benchmarks.py <baseline.json> <current.json> [--threshold 0.10]
+                             [--allocations-threshold 0.0] [--metric real_time|cpu_time]
+
+Time regresses when it grows by more than threshold (relative), allocations
+per operation regress when they grow by more than allocations threshold.
+Benchmarks present in only one of files are reported but do not fail.
+"""
+
+import argparse
+import json
+import sys
+
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+ALLOCATIONS = "allocs/op"
+
+
+def load(filename, metric):
+    with open(filename) as f:
+        data = json.load(f)
+    results = {}
+    for b in data["benchmarks"]:
+        # With repetitions only the mean aggregate is compared
+        if b.get("run_type") == "aggregate" and b.get("aggregate_name") != "mean":
+            continue
+        name = b.get("run_name", b["name"])
+        results[name] = {
+            "time": b[metric] * TIME_UNITS[b.get("time_unit", "ns")],
+            "allocations": b.get(ALLOCATIONS),
+        }
+    return results
+
+
+def growth(baseline, current):
+    if baseline == 0:
+        return 0.0 if current == 0 else float("inf")
+    return current / baseline - 1.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare cic-bench JSON results")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10)
+    parser.add_argument("--allocations-threshold", type=float, default=0.0)
+    parser.add_argument("--metric", choices=["real_time", "cpu_time"], default="cpu_time")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline, args.metric)
+    current = load(args.current, args.metric)
+
+    regressions = 0
+    print("%-45s %14s %14s %9s %12s %12s" % ("Benchmark", "Baseline, ns", "Current, ns", "Time", "Allocs base", "Allocs cur"))
+    for name in sorted(set(baseline) | set(current)):
+        if name not in baseline or name not in current:
+            print("%-45s %s" % (name, "only in baseline" if name in baseline else "only in current"))
+            continue
+        b = baseline[name]
+        c = current[name]
+        status = ""
+        time_growth = growth(b["time"], c["time"])
+        if time_growth > args.threshold:
+            status += " TIME REGRESSION"
+        if b["allocations"] is not None and c["allocations"] is not None:
+            # Rounding hides the framework noise of fractional counts
+            if growth(round(b["allocations"]), round(c["allocations"])) > args.allocations_threshold:
+                status += " ALLOCATIONS REGRESSION"
+            allocations = "%12.1f %12.1f" % (b["allocations"], c["allocations"])
+        else:
+            allocations = "%12s %12s" % ("-", "-")
+        if status:
+            regressions += 1
+        print("%-45s %14.0f %14.0f %+8.1f%% %s%s" % (name, b["time"], c["time"], time_growth * 100, allocations, status))
+
+    if regressions:
+        print("%d benchmark(s) regressed" % regressions)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
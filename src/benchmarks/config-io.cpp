@@ -0,0 +1,227 @@
+#include "allocations.hpp"
+#include "synthetic.hpp"
+#include "layered-loader.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <cstdlib>
+#include <sstream>
+
+using namespace cic;
+using namespace cicbench;
+
+namespace {
+
+/// Groups count and parameters per group
+void schemaSizes(benchmark::internal::Benchmark* b)
+{
+	b->Args({1, 10})->Args({10, 100})->Args({100, 100});
+}
+
+SyntheticSchema schemaOf(const benchmark::State& state)
+{
+	return SyntheticSchema(state.range(0), state.range(1));
+}
+
+void setParametersProcessed(benchmark::State& state, const SyntheticSchema& schema)
+{
+	state.SetItemsProcessed(state.iterations() * schema.groupsCount * schema.parametersCount);
+}
+
+} // namespace
+
+static void BM_ParseIni(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters();
+	TemporaryFile ini(schema.iniText());
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		p->parseIni(ini.name().c_str());
+	}
+	setParametersProcessed(state, schema);
+}
+BENCHMARK(BM_ParseIni)->Apply(schemaSizes);
+
+static void BM_ParseCmdline(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters();
+	p->setCmdlineParser(state.range(2) ? Parameters::CmdlineParser::boost : Parameters::CmdlineParser::native);
+	auto args = schema.cmdline(10);
+	auto argv = makeArgv(args);
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		p->parseCmdline(argv.size(), argv.data());
+	}
+	setParametersProcessed(state, schema);
+}
+BENCHMARK(BM_ParseCmdline)->ArgNames({"groups", "parameters", "boost"})
+	->Args({1, 10, 0})->Args({10, 100, 0})->Args({100, 100, 0})
+	->Args({1, 10, 1})->Args({10, 100, 1})->Args({100, 100, 1});
+
+/// Reload of one changed value, cost is dominated by passes over the whole schema
+static void BM_ParseSingleValue(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters();
+	std::vector<std::string> args{"bench", "--" + SyntheticSchema::groupName(0) + "." + SyntheticSchema::parameterName(0, 0) + "=1"};
+	auto argv = makeArgv(args);
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		p->parseCmdline(argv.size(), argv.data());
+	}
+	setParametersProcessed(state, schema);
+}
+BENCHMARK(BM_ParseSingleValue)->Args({100, 100})->Args({10, 1000});
+
+/// Group reading values of stored command line, as general options are read
+static void BM_ReadPOVarsMap(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters();
+	auto args = schema.cmdline(10);
+	auto argv = makeArgv(args);
+	p->storeCmdline(argv.size(), argv.data());
+	ParametersGroup& group = (*p)[SyntheticSchema::groupName(0)];
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		group.readPOVarsMap(p->variablesMap());
+	}
+	state.SetItemsProcessed(state.iterations() * schema.parametersCount);
+}
+BENCHMARK(BM_ReadPOVarsMap)->Args({1, 100})->Args({1, 1000})->Args({10, 100});
+
+static void BM_QuickReadConfiguration(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters(true);
+	TemporaryFile site(schema.iniText());
+	TemporaryFile local(schema.iniText());
+	auto args = schema.cmdline(10);
+	auto argv = makeArgv(args);
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(PreconfiguredOperations::quickReadConfiguration(
+				*p, {site.name(), local.name()}, argv.size(), argv.data()));
+	}
+	setParametersProcessed(state, schema);
+}
+BENCHMARK(BM_QuickReadConfiguration)->Apply(schemaSizes);
+
+static void BM_GroupGet(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters();
+	ParametersGroup& group = (*p)[SyntheticSchema::groupName(0)];
+	// Only integer parameters, in random order
+	std::vector<std::string> names;
+	for (size_t i = 0; i < schema.parametersCount; i += 4)
+		names.push_back(SyntheticSchema::parameterName(0, i));
+	std::shuffle(names.begin(), names.end(), std::mt19937(42));
+
+	size_t i = 0;
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(group.get<int>(names[i]));
+		if (++i == names.size())
+			i = 0;
+	}
+}
+BENCHMARK(BM_GroupGet)->Apply(schemaSizes);
+
+static void BM_WriteIni(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters();
+	TemporaryFile ini(schema.iniText());
+	p->parseIni(ini.name().c_str());
+	std::ostringstream stream;
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		stream.str(std::string());
+		p->writeIni(stream);
+	}
+	setParametersProcessed(state, schema);
+}
+BENCHMARK(BM_WriteIni)->Apply(schemaSizes);
+
+static void BM_WriteIniFile(benchmark::State& state)
+{
+	SyntheticSchema schema(state.range(0), state.range(1));
+	auto p = schema.makeParameters();
+	TemporaryFile ini(schema.iniText());
+	p->parseIni(ini.name().c_str());
+	const bool atomic = state.range(2) != 0;
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		p->writeIni(ini.name().c_str(), atomic);
+	}
+	setParametersProcessed(state, schema);
+}
+BENCHMARK(BM_WriteIniFile)->ArgNames({"groups", "parameters", "atomic"})
+	->Args({10, 100, 0})->Args({100, 100, 0})->Args({100, 100, 1});
+
+static void BM_CmdlineHelp(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters(true);
+	std::ostringstream stream;
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		stream.str(std::string());
+		p->cmdlineHelp(stream);
+	}
+	setParametersProcessed(state, schema);
+}
+BENCHMARK(BM_CmdlineHelp)->Apply(schemaSizes);
+
+static void BM_LoadEnvironment(benchmark::State& state)
+{
+	SyntheticSchema schema = schemaOf(state);
+	auto p = schema.makeParameters();
+	auto variables = schema.environment("BENCH", 10);
+	for (auto& v : variables)
+		setenv(v.first.c_str(), v.second.c_str(), 1);
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		LayeredLoader loader(*p);
+		loader.addEnvironment("BENCH");
+		loader.apply();
+	}
+	for (auto& v : variables)
+		unsetenv(v.first.c_str());
+	setParametersProcessed(state, schema);
+}
+BENCHMARK(BM_LoadEnvironment)->Apply(schemaSizes);
+
+static void BM_LayeredLoad(benchmark::State& state)
+{
+	// A dozen of layers like site, cluster, role, host and local overrides
+	SyntheticSchema schema(100, 100);
+	auto p = schema.makeParameters();
+	std::vector<std::unique_ptr<TemporaryFile>> files;
+	for (int i = 0; i < 12; i++)
+		files.emplace_back(new TemporaryFile(schema.iniText()));
+	AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		LayeredLoader loader(*p);
+		loader.setMaxThreads(state.range(0));
+		for (auto& f : files)
+			loader.addIni(f->name());
+		loader.apply();
+	}
+}
+BENCHMARK(BM_LayeredLoad)->ArgName("threads")->Arg(1)->Arg(4)->UseRealTime();
@@ -0,0 +1,130 @@
+#include "counting-allocator.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+using namespace cicbench;
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+std::atomic<int64_t> bytes{0};
+
+void* allocate(std::size_t size, std::size_t alignment = 0)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	while (true)
+	{
+		void* p = alignment == 0 ? std::malloc(size) : std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+		if (p != nullptr)
+		{
+			bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed);
+			return p;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void release(void* p)
+{
+	if (p == nullptr)
+		return;
+	bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+	std::free(p);
+}
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try {
+		return allocate(size);
+	} catch (std::bad_alloc&) {
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+// std::pmr::new_delete_resource() uses aligned versions
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept
+{
+	release(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	release(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	release(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	release(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	release(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	release(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+	release(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+	release(p);
+}
+
+uint64_t cicbench::allocationsCount()
+{
+	return allocations.load(std::memory_order_relaxed);
+}
+
+int64_t cicbench::allocatedBytes()
+{
+	return bytes.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,24 @@
+/*
+ * counting-allocator.hpp
+ *
+ * Heap allocations counting shared by benchmarks and allocation tests.
+ * Global operator new is replaced in counting-allocator.cpp, so every
+ * allocation of a binary linked with it is counted
+ */
+
+#ifndef CIC_BENCH_COUNTING_ALLOCATOR_HPP_
+#define CIC_BENCH_COUNTING_ALLOCATOR_HPP_
+
+#include <cstdint>
+
+namespace cicbench {
+
+/// Total count of operator new calls since program start
+uint64_t allocationsCount();
+
+/// Size of memory blocks allocated by operator new and not released yet
+int64_t allocatedBytes();
+
+} // namespace cicbench
+
+#endif /* CIC_BENCH_COUNTING_ALLOCATOR_HPP_ */
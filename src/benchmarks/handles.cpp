@@ -0,0 +1,147 @@
+#include "cic.hpp"
+#include "static-schema.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <thread>
+
+using namespace cic;
+
+namespace {
+
+Parameters makeParameters()
+{
+	return Parameters(
+		"Benchmark parameters",
+		ParametersGroup(
+			"General",
+			"General program options",
+			Parameter<std::string>("load-ini", "Load settings from ini file", ParamterType::cmdLine),
+			Parameter<std::string>("save-ini", "Save setting to ini file", ParamterType::cmdLine),
+			Parameter<bool>("help", "Print help", ParamterType::cmdLine)
+		),
+		ParametersGroup(
+			"Input",
+			"Input parameters",
+			Parameter<double>("k", "Value of k", 1.23),
+			Parameter<double>("b", "Value of b", 9.87)
+		),
+		ParametersGroup(
+			"Interface",
+			"User interface parameters",
+			Parameter<std::string>("greeter", "String parameter", "Hi, user.")
+		)
+	);
+}
+
+struct Input
+{
+	CIC_STATIC_PARAMETER(k, double, "k", "Value of k", 1.23);
+	CIC_STATIC_PARAMETER(b, double, "b", "Value of b", 9.87);
+	CIC_STATIC_GROUP("Input", "Input parameters", k, b);
+};
+
+/// Shared by all threads of concurrent benchmarks, never destroyed
+Parameters& concurrentParameters()
+{
+	static Parameters* p = [] {
+		Parameters* result = new Parameters(makeParameters());
+		result->enableConcurrentReads();
+		return result;
+	}();
+	return *p;
+}
+
+} // namespace
+
+static void BM_GetByName(benchmark::State& state)
+{
+	Parameters p = makeParameters();
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(p["Input"].get<double>("k"));
+	}
+}
+BENCHMARK(BM_GetByName);
+
+static void BM_GetByGroupReference(benchmark::State& state)
+{
+	Parameters p = makeParameters();
+	ParametersGroup& input = p["Input"];
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(input.get<double>("k"));
+	}
+}
+BENCHMARK(BM_GetByGroupReference);
+
+static void BM_GetByHandle(benchmark::State& state)
+{
+	Parameters p = makeParameters();
+	Handle<double> k = p.handle<double>("Input", "k");
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(k.get());
+	}
+}
+BENCHMARK(BM_GetByHandle);
+
+static void BM_GetByStaticSchema(benchmark::State& state)
+{
+	Parameters p("Benchmark parameters");
+	StaticSchema<Input> schema(p);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(schema.get<Input::k>());
+	}
+}
+BENCHMARK(BM_GetByStaticSchema);
+
+static void BM_GetByBoundVariable(benchmark::State& state)
+{
+	Parameters p = makeParameters();
+	double k = 0;
+	p["Input"].bind("k", &k);
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(k);
+	}
+}
+BENCHMARK(BM_GetByBoundVariable);
+
+/// Readers scaling with and without thread that parses command line in a loop
+static void BM_ConcurrentRead(benchmark::State& state)
+{
+	Parameters& p = concurrentParameters();
+	Handle<double> k = p.handle<double>("Input", "k");
+	Handle<std::string> greeter = p.handle<std::string>("Interface", "greeter");
+	const bool withGreeter = state.range(1) != 0;
+
+	std::atomic<bool> stop{false};
+	std::thread writer;
+	if (state.thread_index() == 0 && state.range(0) != 0)
+	{
+		writer = std::thread([&p, &stop] {
+			const char* argv[] = {"bench", "--Input.k=2.5", "--Interface.greeter=Hello"};
+			const char* argvBack[] = {"bench", "--Input.k=1.23", "--Interface.greeter=Hi, user."};
+			for (unsigned i = 0; !stop.load(std::memory_order_relaxed); i++)
+				p.parseCmdline(3, i % 2 == 0 ? argv : argvBack);
+		});
+	}
+
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(k.read());
+		if (withGreeter)
+			benchmark::DoNotOptimize(greeter.read());
+	}
+
+	if (writer.joinable())
+	{
+		stop = true;
+		writer.join();
+	}
+}
+BENCHMARK(BM_ConcurrentRead)->ArgNames({"writer", "string"})
+	->ArgsProduct({{0, 1}, {0, 1}})->ThreadRange(1, 8)->UseRealTime();
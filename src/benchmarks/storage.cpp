@@ -0,0 +1,156 @@
+#include "allocations.hpp"
+#include "synthetic.hpp"
+#include "cic.hpp"
+#include "perfect-hash.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+using namespace cic;
+
+namespace {
+
+std::string parameterName(size_t i)
+{
+	return "parameter-" + std::to_string(i);
+}
+
+std::string groupName(size_t i)
+{
+	return "Group" + std::to_string(i);
+}
+
+/// Random order of names to look up, so that cache misses are not hidden
+std::vector<std::string> shuffledNames(size_t count, std::string (*name)(size_t))
+{
+	std::vector<std::string> names;
+	for (size_t i = 0; i < count; i++)
+		names.push_back(name(i));
+	std::shuffle(names.begin(), names.end(), std::mt19937(42));
+	return names;
+}
+
+void fillGroup(ParametersGroup& g, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		g.add(Parameter<int>(parameterName(i).c_str(), "Integer parameter", static_cast<int>(i)));
+}
+
+} // namespace
+
+static void BM_ParameterLookup(benchmark::State& state)
+{
+	ParametersGroup g("Group");
+	fillGroup(g, state.range(0));
+	auto names = shuffledNames(state.range(0), parameterName);
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(g.findParameter(names[i]));
+		if (++i == names.size())
+			i = 0;
+	}
+}
+BENCHMARK(BM_ParameterLookup)->Arg(10)->Arg(1000)->Arg(100000);
+
+/// Lookup in tables generated by cic-schema-gen: one hash and one comparison
+static void BM_PerfectHashLookup(benchmark::State& state)
+{
+	std::vector<std::string> stored;
+	for (int64_t i = 0; i < state.range(0); i++)
+		stored.push_back(parameterName(i));
+	std::vector<std::pair<std::string_view, std::string_view>> keys;
+	for (auto& name : stored)
+		keys.emplace_back("Group", name);
+	std::vector<uint32_t> slots;
+	std::vector<int32_t> displacements = PerfectHash::build(keys, slots);
+	PerfectHash hash(displacements.data(), displacements.size());
+	std::vector<std::string_view> bySlot(keys.size());
+	for (size_t i = 0; i < keys.size(); i++)
+		bySlot[slots[i]] = stored[i];
+
+	auto names = shuffledNames(state.range(0), parameterName);
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(bySlot[hash.slot("Group", names[i])] == names[i]);
+		if (++i == names.size())
+			i = 0;
+	}
+}
+BENCHMARK(BM_PerfectHashLookup)->Arg(10)->Arg(1000)->Arg(100000);
+
+static void BM_GroupLookup(benchmark::State& state)
+{
+	Parameters p;
+	for (int64_t i = 0; i < state.range(0); i++)
+		p.addGroup(ParametersGroup(groupName(i).c_str(), Parameter<int>("parameter", "Integer parameter", 1)));
+	auto names = shuffledNames(state.range(0), groupName);
+	size_t i = 0;
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(p.group(names[i]));
+		if (++i == names.size())
+			i = 0;
+	}
+}
+BENCHMARK(BM_GroupLookup)->Arg(10)->Arg(1000)->Arg(100000);
+
+static void BM_FullWalk(benchmark::State& state)
+{
+	ParametersGroup g("Group");
+	fillGroup(g, state.range(0));
+	// Group is present but has no values, so every parameter is visited
+	boost::property_tree::ptree pt;
+	pt.put_child("Group", boost::property_tree::ptree());
+	for (auto _ : state)
+	{
+		benchmark::DoNotOptimize(g.readPT(pt));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FullWalk)->Arg(10)->Arg(1000)->Arg(100000);
+
+static void BM_BuildSchema(benchmark::State& state)
+{
+	const bool arena = state.range(0) != 0;
+	std::vector<std::string> names;
+	for (int64_t i = 0; i < state.range(1); i++)
+		names.push_back(parameterName(i));
+
+	cicbench::AllocationsCounter allocations(state);
+	for (auto _ : state)
+	{
+		Parameters p;
+		ParametersGroup* g;
+		if (arena)
+		{
+			g = &p.createGroup("Group", "Group description");
+		} else {
+			p.addGroup(ParametersGroup("Group", "Group description"));
+			g = &p["Group"];
+		}
+		for (auto& name : names)
+			g->add(Parameter<int>(name.c_str(), "Integer parameter with description", 1));
+		benchmark::DoNotOptimize(g->findParameter(names.front()));
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(1));
+}
+BENCHMARK(BM_BuildSchema)->ArgNames({"arena", "parameters"})->ArgsProduct({{0, 1}, {1000, 50000}});
+
+/// Heap bytes held by built schema, interned texts that already exist are not counted
+static void BM_SchemaFootprint(benchmark::State& state)
+{
+	cicbench::SyntheticSchema schema(state.range(0), state.range(1));
+	int64_t bytes = 0;
+	for (auto _ : state)
+	{
+		const int64_t before = cicbench::allocatedBytes();
+		auto p = schema.makeParameters();
+		bytes += cicbench::allocatedBytes() - before;
+	}
+	state.counters["bytes/param"] = benchmark::Counter(
+			static_cast<double>(bytes) / (schema.groupsCount * schema.parametersCount), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_SchemaFootprint)->ArgNames({"groups", "parameters"})->Args({10, 1000})->Args({100, 100});
@@ -0,0 +1,134 @@
+#include "synthetic.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+
+using namespace cic;
+using namespace cicbench;
+
+namespace {
+
+std::string valueText(size_t parameter, size_t seed)
+{
+	switch (parameter % 4)
+	{
+	case 0: return std::to_string(seed);
+	case 1: return std::to_string(seed) + ".25";
+	case 2: return "text-" + std::to_string(seed);
+	default: return seed % 2 ? "true" : "false";
+	}
+}
+
+} // namespace
+
+SyntheticSchema::SyntheticSchema(size_t groupsCount, size_t parametersCount) :
+		groupsCount(groupsCount), parametersCount(parametersCount)
+{
+}
+
+std::string SyntheticSchema::groupName(size_t group)
+{
+	return "Group" + std::to_string(group);
+}
+
+std::string SyntheticSchema::parameterName(size_t group, size_t parameter)
+{
+	return "g" + std::to_string(group) + "-p" + std::to_string(parameter);
+}
+
+std::unique_ptr<Parameters> SyntheticSchema::makeParameters(bool generalOptions) const
+{
+	std::unique_ptr<Parameters> p(new Parameters("Synthetic benchmark parameters"));
+	if (generalOptions)
+		PreconfiguredOperations::addGeneralOptions(*p);
+
+	for (size_t g = 0; g < groupsCount; g++)
+	{
+		ParametersGroup group(groupName(g).c_str(), "Generated group");
+		for (size_t i = 0; i < parametersCount; i++)
+		{
+			std::string name = parameterName(g, i);
+			switch (i % 4)
+			{
+			case 0: group.add(Parameter<int>(name.c_str(), "Integer parameter", 0)); break;
+			case 1: group.add(Parameter<double>(name.c_str(), "Floating point parameter", 0.5)); break;
+			case 2: group.add(Parameter<std::string>(name.c_str(), "String parameter", "default")); break;
+			default: group.add(Parameter<bool>(name.c_str(), "Boolean parameter", false)); break;
+			}
+		}
+		p->addGroup(std::move(group));
+	}
+	return p;
+}
+
+std::string SyntheticSchema::iniText() const
+{
+	std::string text;
+	for (size_t g = 0; g < groupsCount; g++)
+	{
+		text += "[" + groupName(g) + "]\n";
+		for (size_t i = 0; i < parametersCount; i++)
+			text += parameterName(g, i) + " = " + valueText(i, g + i) + "\n";
+		text += "\n";
+	}
+	return text;
+}
+
+std::vector<std::string> SyntheticSchema::cmdline(size_t step) const
+{
+	std::vector<std::string> args{"cic-bench"};
+	for (size_t g = 0; g < groupsCount; g++)
+	{
+		for (size_t i = 0; i < parametersCount; i += step)
+			args.push_back("--" + groupName(g) + "." + parameterName(g, i) + "=" + valueText(i, g * i + 1));
+	}
+	return args;
+}
+
+std::vector<std::pair<std::string, std::string>> SyntheticSchema::environment(const std::string& prefix, size_t step) const
+{
+	std::vector<std::pair<std::string, std::string>> variables;
+	for (size_t g = 0; g < groupsCount; g++)
+	{
+		for (size_t i = 0; i < parametersCount; i += step)
+		{
+			std::string name = prefix + "_";
+			cic::SystemUtils::appendEnvironmentName(name, groupName(g));
+			name += '_';
+			cic::SystemUtils::appendEnvironmentName(name, parameterName(g, i));
+			variables.emplace_back(std::move(name), valueText(i, g * i + 2));
+		}
+	}
+	return variables;
+}
+
+TemporaryFile::TemporaryFile(const std::string& contents)
+{
+	const char* tmpdir = std::getenv("TMPDIR");
+	std::string pattern = std::string(tmpdir != nullptr ? tmpdir : "/tmp") + "/cic-bench-XXXXXX.ini";
+	int fd = mkstemps(&pattern[0], 4);
+	if (fd < 0)
+		throw std::runtime_error("Cannot create temporary file " + pattern);
+	close(fd);
+	m_name = pattern;
+
+	std::ofstream f(m_name, std::ios::out | std::ios::trunc);
+	f << contents;
+}
+
+TemporaryFile::~TemporaryFile()
+{
+	std::remove(m_name.c_str());
+}
+
+std::vector<const char*> cicbench::makeArgv(const std::vector<std::string>& args)
+{
+	std::vector<const char*> argv;
+	for (auto& arg : args)
+		argv.push_back(arg.c_str());
+	return argv;
+}
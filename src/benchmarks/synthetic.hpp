@@ -0,0 +1,64 @@
+/*
+ * synthetic.hpp
+ *
+ * Generated schemas, ini files and command lines of scalable size
+ */
+
+#ifndef CIC_BENCH_SYNTHETIC_HPP_
+#define CIC_BENCH_SYNTHETIC_HPP_
+
+#include "cic.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cicbench {
+
+/**
+ * Schema of groupsCount groups with parametersCount parameters each.
+ * Parameter types cycle through int, double, std::string and bool, names
+ * are unique among all groups so short command line names are not ambiguous
+ */
+struct SyntheticSchema
+{
+	SyntheticSchema(size_t groupsCount, size_t parametersCount);
+
+	static std::string groupName(size_t group);
+	static std::string parameterName(size_t group, size_t parameter);
+
+	/// General options group from PreconfiguredOperations is added if requested
+	std::unique_ptr<cic::Parameters> makeParameters(bool generalOptions = false) const;
+
+	/// Ini file with values for every parameter
+	std::string iniText() const;
+
+	/// Arguments setting every step-th parameter by its full name, argv[0] included
+	std::vector<std::string> cmdline(size_t step) const;
+
+	/// Environment variables (name and value) setting every step-th parameter
+	std::vector<std::pair<std::string, std::string>> environment(const std::string& prefix, size_t step) const;
+
+	size_t groupsCount;
+	size_t parametersCount;
+};
+
+/// File in temporary directory removed by destructor
+class TemporaryFile
+{
+public:
+	TemporaryFile(const std::string& contents);
+	~TemporaryFile();
+
+	const std::string& name() const { return m_name; }
+
+private:
+	std::string m_name;
+};
+
+/// argv-like array pointing to strings that should outlive it
+std::vector<const char*> makeArgv(const std::vector<std::string>& args);
+
+} // namespace cicbench
+
+#endif /* CIC_BENCH_SYNTHETIC_HPP_ */
@@ -0,0 +1,27 @@
+# cic_generate_schema(<target> <schema.ini> [NAMESPACE <namespace>])
+#
+# Compiles schema file by cic-schema-gen into <name>.hpp and <name>.cpp, where
+# <name> is the schema file name without extension, and adds them to target.
+# Namespace defaults to <name> with characters not allowed in identifiers
+# replaced by '_'. See src/schema-gen/schema-gen.cpp for the schema syntax
+function(cic_generate_schema target schema)
+    cmake_parse_arguments(CIC_SCHEMA "" "NAMESPACE" "" ${ARGN})
+    get_filename_component(schema_path ${schema} ABSOLUTE)
+    get_filename_component(name ${schema} NAME_WE)
+    if(NOT CIC_SCHEMA_NAMESPACE)
+        string(MAKE_C_IDENTIFIER ${name} CIC_SCHEMA_NAMESPACE)
+    endif()
+
+    set(output_dir ${CMAKE_CURRENT_BINARY_DIR}/cic-schema)
+    set(header ${output_dir}/${name}.hpp)
+    set(source ${output_dir}/${name}.cpp)
+    file(MAKE_DIRECTORY ${output_dir})
+    add_custom_command(
+        OUTPUT ${header} ${source}
+        COMMAND cic-schema-gen ${schema_path} ${header} ${source} ${CIC_SCHEMA_NAMESPACE}
+        DEPENDS cic-schema-gen ${schema_path}
+        COMMENT "Generating schema ${name}"
+    )
+    target_sources(${target} PRIVATE ${header} ${source})
+    target_include_directories(${target} PRIVATE ${output_dir})
+endfunction()
@@ -0,0 +1,193 @@
+#include "binary-cache.hpp"
+#include "cic.hpp"
+
+#include <unordered_map>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+
+using namespace cic;
+
+namespace {
+
+struct ImageHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t valuesCount;
+	uint64_t schemaHash;
+	uint64_t size;
+	int64_t mtimeSec;
+	int64_t mtimeNsec;
+	uint64_t inode;
+	uint64_t device;
+	uint32_t pathLength;
+	uint32_t reserved;
+};
+
+struct ValueHeader
+{
+	uint32_t group;
+	uint32_t parameter;
+	uint32_t size;
+};
+
+const char imageMagic[8] = {'C', 'I', 'C', 'I', 'M', 'G', '\0', '\0'};
+
+template <typename T>
+bool readPod(std::string_view& data, T& value)
+{
+	if (data.size() < sizeof(T))
+		return false;
+	std::memcpy(&value, data.data(), sizeof(T));
+	data.remove_prefix(sizeof(T));
+	return true;
+}
+
+template <typename T>
+void appendPod(std::string& buffer, const T& value)
+{
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+void BinaryImage::apply() const
+{
+	for (const Value& v : m_values)
+	{
+		if (!v.parameter->readBinary(v.data))
+			throw std::runtime_error(std::string("Damaged configuration image ") + m_imagePath
+					+ ", value of " + std::string(v.parameter->name()));
+	}
+}
+
+BinaryCache::BinaryCache(const std::string& directory) :
+		m_directory(directory)
+{
+}
+
+bool BinaryCache::load(const Schema& schema, const std::string& iniFile, BinaryImage& image) const
+{
+	TraceSpan span("load image");
+	span.arg("file", iniFile);
+	FileStamp stamp;
+	if (!FileStamp::ofFile(iniFile, stamp))
+		return false;
+
+	image.m_imagePath = imagePath(iniFile);
+	try {
+		image.m_file = MappedFile(image.m_imagePath);
+	} catch (std::runtime_error&) {
+		return false;
+	}
+
+	std::string_view data = image.m_file.text();
+	ImageHeader header;
+	if (!readPod(data, header)
+		|| std::memcmp(header.magic, imageMagic, sizeof(imageMagic)) != 0
+		|| header.version != formatVersion
+		|| header.schemaHash != schema.hash
+		|| header.size != stamp.size
+		|| header.mtimeSec != stamp.mtimeSec
+		|| header.mtimeNsec != stamp.mtimeNsec
+		|| header.inode != stamp.inode
+		|| header.device != stamp.device
+		|| data.size() < header.pathLength
+		|| data.substr(0, header.pathLength) != absolutePath(iniFile))
+	{
+		return false;
+	}
+	data.remove_prefix(header.pathLength);
+
+	image.m_values.clear();
+	image.m_values.reserve(header.valuesCount);
+	for (uint32_t i = 0; i < header.valuesCount; i++)
+	{
+		ValueHeader value;
+		if (!readPod(data, value) || data.size() < value.size || value.group >= schema.groups.size())
+			return false;
+		auto& groupParameters = schema.groups[value.group];
+		if (value.parameter >= groupParameters.size())
+			return false;
+
+		image.m_values.push_back(BinaryImage::Value{groupParameters[value.parameter], data.substr(0, value.size)});
+		data.remove_prefix(value.size);
+	}
+	span.arg("values", image.m_values.size());
+	return data.empty();
+}
+
+void BinaryCache::save(const Schema& schema, const std::string& iniFile, const FileStamp& stamp,
+		const std::vector<std::pair<IAnyTypeParameter*, std::string>>& values) const
+{
+	// Position of every parameter in name-ordered schema
+	std::unordered_map<const IAnyTypeParameter*, std::pair<uint32_t, uint32_t>> positions;
+	for (uint32_t g = 0; g < schema.groups.size(); g++)
+	{
+		for (uint32_t p = 0; p < schema.groups[g].size(); p++)
+			positions[schema.groups[g][p]] = std::make_pair(g, p);
+	}
+
+	std::string path = absolutePath(iniFile);
+	ImageHeader header;
+	std::memcpy(header.magic, imageMagic, sizeof(imageMagic));
+	header.version = formatVersion;
+	header.valuesCount = values.size();
+	header.schemaHash = schema.hash;
+	header.size = stamp.size;
+	header.mtimeSec = stamp.mtimeSec;
+	header.mtimeNsec = stamp.mtimeNsec;
+	header.inode = stamp.inode;
+	header.device = stamp.device;
+	header.pathLength = path.size();
+	header.reserved = 0;
+
+	TraceSpan span("save image");
+	span.arg("file", iniFile);
+	std::string buffer;
+	appendPod(buffer, header);
+	buffer.append(path);
+	for (auto& v : values)
+	{
+		auto it = positions.find(v.first);
+		if (it == positions.end())
+			return;
+		appendPod(buffer, ValueHeader{it->second.first, it->second.second, static_cast<uint32_t>(v.second.size())});
+		buffer.append(v.second);
+	}
+
+	// Lost image is only parsed again, so it is not synced to disk
+	try {
+		SystemUtils::writeFile(imagePath(iniFile), buffer, true, false);
+	} catch (std::runtime_error&) {
+	}
+}
+
+std::string BinaryCache::imagePath(const std::string& iniFile) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.cicimg", static_cast<unsigned long long>(hash(absolutePath(iniFile))));
+	return m_directory + "/" + name;
+}
+
+uint64_t BinaryCache::hash(std::string_view data, uint64_t seed)
+{
+	// FNV-1a
+	uint64_t h = seed;
+	for (char c : data)
+	{
+		h ^= static_cast<unsigned char>(c);
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+std::string BinaryCache::absolutePath(const std::string& file)
+{
+	char resolved[PATH_MAX];
+	if (realpath(file.c_str(), resolved) == nullptr)
+		return file;
+	return resolved;
+}
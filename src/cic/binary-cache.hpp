@@ -0,0 +1,98 @@
+/*
+ * binary-cache.hpp
+ *
+ * Compiled images of values resolved from ini files. An image is keyed by
+ * schema hash and by path, size, mtime and inode of its source file, so
+ * loading a valid image skips text parsing and conversion entirely.
+ */
+
+#ifndef CIC_BINARY_CACHE_HPP_
+#define CIC_BINARY_CACHE_HPP_
+
+#include "ini-parser.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+namespace cic {
+
+class IAnyTypeParameter;
+
+/**
+ * Values of one ini file loaded from compiled image. Value data points
+ * into mapped image file
+ */
+class BinaryImage
+{
+public:
+	struct Value
+	{
+		IAnyTypeParameter* parameter;
+		std::string_view data;
+	};
+
+	const std::vector<Value>& values() const { return m_values; }
+
+	/// Set all parameters, throws if image contents is damaged
+	void apply() const;
+
+private:
+	friend class BinaryCache;
+
+	std::string m_imagePath;
+	MappedFile m_file;
+	std::vector<Value> m_values;
+};
+
+/**
+ * Directory with compiled images. Image file format (native byte order):
+ * header, absolute path of ini file, then for every value
+ * group index, parameter index, data size and data. Indexes are positions
+ * in name-ordered groups and parameters, they are valid because schema hash
+ * is checked first.
+ */
+class BinaryCache
+{
+public:
+	static constexpr uint32_t formatVersion = 1;
+
+	/**
+	 * Schema images refer to, taken by Parameters::binarySchema(). Loads only
+	 * read it, so several files are loaded concurrently
+	 */
+	struct Schema
+	{
+		/// Hash of names and types of all parameters
+		uint64_t hash = 0;
+		/// Parameters of name-ordered groups, each group in name order
+		std::vector<std::vector<IAnyTypeParameter*>> groups;
+	};
+
+	explicit BinaryCache(const std::string& directory);
+
+	/// Returns false if there is no image for the file or it does not match file or schema
+	bool load(const Schema& schema, const std::string& iniFile, BinaryImage& image) const;
+
+	/**
+	 * Store image for given ini file state. Values are raw values written
+	 * by IAnyTypeParameter::writeBinary(). Errors are ignored because cache
+	 * is only an optimization, image is replaced atomically
+	 */
+	void save(const Schema& schema, const std::string& iniFile, const FileStamp& stamp,
+			const std::vector<std::pair<IAnyTypeParameter*, std::string>>& values) const;
+
+	std::string imagePath(const std::string& iniFile) const;
+
+	static uint64_t hash(std::string_view data, uint64_t seed = 14695981039346656037ull);
+
+private:
+	static std::string absolutePath(const std::string& file);
+
+	std::string m_directory;
+};
+
+} // namespace cic
+
+#endif /* CIC_BINARY_CACHE_HPP_ */
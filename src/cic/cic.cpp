@@ -1,12 +1,22 @@
 #include "cic.hpp"
+#include "layered-loader.hpp"
 
 #include <boost/filesystem.hpp>
-#include <boost/property_tree/ini_parser.hpp>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <fstream>
+#include <mutex>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <pwd.h>
+#include <unistd.h>
 
 using namespace cic;
 
@@ -18,36 +28,23 @@ void Parameter<bool>::addToPO(boost::program_options::options_description& od, c
 		if (m_isInitialized && defaultsNeeded)
 		{
 			od.add_options()
-				((prefix + m_name).c_str(), boost::program_options::value<bool>()->default_value(m_value), m_description.c_str());
+				((prefix + m_name.c_str()).c_str(), typedValue<bool>()->defaultValue(m_value), m_description.c_str());
 		} else {
 			od.add_options()
-				((prefix + m_name).c_str(), m_description.c_str());
+				((prefix + m_name.c_str()).c_str(), m_description.c_str());
 		}
 	}
 }
 
 template<>
-bool Parameter<bool>::getFromPO(const boost::program_options::variables_map& clOpts, const std::string& optionalPrefix)
+bool Parameter<bool>::getFromPO(const boost::program_options::variable_value& value)
 {
-	if (m_parType == ParamterType::cmdLine || m_parType == ParamterType::both)
-	{
-		auto tryName = [this, &clOpts](const std::string& name) -> bool {
-			if (clOpts.count(name.c_str()) == 0)
-				return false;
-
-			try {
-				m_value = clOpts[name.c_str()].as<bool>();
-			} catch (std::exception &) {
-				m_value = true;
-			}
-			m_setByUser = true;
-			m_isInitialized = true;
-			return true;
-		};
-		if (!tryName(optionalPrefix + m_name))
-			tryName(m_name);
-	}
-	return initialized();
+	if (m_parType != ParamterType::cmdLine && m_parType != ParamterType::both)
+		return false;
+	// Flag without value has no stored value
+	const bool* flag = boost::any_cast<bool>(&value.value());
+	assign(flag != nullptr ? *flag : true);
+	return true;
 }
 
 template<>
@@ -57,17 +54,158 @@ void Parameter<bool>::initNoDefault()
 	m_isInitialized = true;
 }
 
+namespace {
+
+/**
+ * Every change of any schema takes the next value, so the largest stamp of
+ * Parameters changes even if a group is replaced by one of other size
+ */
+unsigned long nextSchemaStamp()
+{
+	static std::atomic<unsigned long> counter{0};
+	return ++counter;
+}
+
+[[noreturn]] void throwIniValueError(const IniEntry& entry, const IniDocument& ini)
+{
+	throw std::runtime_error(std::string("Parsing error in ") + ini.filename()
+			+ ":" + std::to_string(entry.line) + " - conversion of value '"
+			+ std::string(entry.value) + "' failed");
+}
+
+/**
+ * Interned texts are never released, so pool is never destroyed either.
+ * Texts are stored one after another in large blocks and found by open
+ * addressing table, so lookup usually touches only one slot and the text
+ */
+class StringPool
+{
+public:
+	static StringPool& instance()
+	{
+		static StringPool* pool = new StringPool();
+		return *pool;
+	}
+
+	/// nullptr if text is not interned yet
+	const char* find(std::string_view text, uint32_t hash) const
+	{
+		size_t mask = m_slots.size() - 1;
+		for (size_t i = hash & mask; m_slots[i].data != nullptr; i = (i + 1) & mask)
+		{
+			const Slot& slot = m_slots[i];
+			if (slot.hash == hash && slot.size == text.size() && memcmp(slot.data, text.data(), text.size()) == 0)
+				return slot.data;
+		}
+		return nullptr;
+	}
+
+	const char* insert(std::string_view text, uint32_t hash)
+	{
+		if ((m_count + 1) * 2 > m_slots.size())
+			grow();
+		const char* data = store(text);
+		place(Slot{data, static_cast<uint32_t>(text.size()), hash});
+		m_count++;
+		return data;
+	}
+
+	std::mutex mutex;
+
+private:
+	static constexpr size_t blockSize = 16384;
+
+	struct Slot
+	{
+		const char* data = nullptr;
+		uint32_t size = 0;
+		uint32_t hash = 0;
+	};
+
+	StringPool() : m_slots(1024) { }
+
+	const char* store(std::string_view text)
+	{
+		const size_t size = text.size() + 1;
+		if (size > m_freeSize)
+		{
+			// Texts longer than block get blocks of their own
+			const size_t newBlockSize = std::max(size, blockSize);
+			m_blocks.emplace_back(new char[newBlockSize]);
+			m_free = m_blocks.back().get();
+			m_freeSize = newBlockSize;
+		}
+		char* data = m_free;
+		memcpy(data, text.data(), text.size());
+		data[text.size()] = '\0';
+		m_free += size;
+		m_freeSize -= size;
+		return data;
+	}
+
+	void place(const Slot& slot)
+	{
+		size_t mask = m_slots.size() - 1;
+		size_t i = slot.hash & mask;
+		while (m_slots[i].data != nullptr)
+			i = (i + 1) & mask;
+		m_slots[i] = slot;
+	}
+
+	void grow()
+	{
+		std::vector<Slot> old(m_slots.size() * 2);
+		old.swap(m_slots);
+		for (const Slot& slot : old)
+		{
+			if (slot.data != nullptr)
+				place(slot);
+		}
+	}
+
+	std::vector<Slot> m_slots;
+	size_t m_count = 0;
+	std::vector<std::unique_ptr<char[]>> m_blocks;
+	char* m_free = nullptr;
+	size_t m_freeSize = 0;
+};
+
+} // namespace
+
+StaticString StaticString::intern(std::string_view text)
+{
+	if (text.empty())
+		return borrow("");
+	const uint32_t hash = static_cast<uint32_t>(std::hash<std::string_view>()(text));
+	StringPool& pool = StringPool::instance();
+	std::lock_guard<std::mutex> lock(pool.mutex);
+	const char* data = pool.find(text, hash);
+	if (data == nullptr)
+		data = pool.insert(text, hash);
+	return StaticString(data, text.size());
+}
+
 ParametersGroup::ParametersGroup(const char* groupName, const char* description) :
 		m_groupName(groupName),
 		m_description(description)
 {
 }
 
+ParametersGroup::ParametersGroup(const char* groupName, const char* description, std::pmr::memory_resource* resource) :
+		m_groupName(groupName),
+		m_description(description),
+		m_resource(resource)
+{
+}
+
 ParametersGroup::ParametersGroup(ParametersGroup&& pg) :
 		m_optionsDescr(std::move(pg.m_optionsDescr)),
 		m_optionsDescrWithGroup(std::move(pg.m_optionsDescrWithGroup)),
+		m_revision(pg.m_revision),
 		m_groupName(std::move(pg.m_groupName)),
-		m_description(std::move(pg.m_description)),
+		m_description(pg.m_description),
+		m_resource(pg.m_resource),
+		m_lock(std::move(pg.m_lock)),
 		m_parameters(std::move(pg.m_parameters))
 {
 }
@@ -77,84 +215,151 @@ const std::string& ParametersGroup::name()
 	return m_groupName;
 }
 
-void ParametersGroup::add(const IAnyTypeParameter& parameter)
+IAnyTypeParameter& ParametersGroup::add(const IAnyTypeParameter& parameter)
+{
+	return store(parameter.copy(*m_resource));
+}
+
+IAnyTypeParameter& ParametersGroup::add(IAnyTypeParameter&& parameter)
+{
+	return store(parameter.move(*m_resource));
+}
+
+IAnyTypeParameter& ParametersGroup::store(IAnyTypeParameter* stored)
 {
-	m_parameters[parameter.name()] = std::unique_ptr<IAnyTypeParameter>(parameter.copy());
+	stored->setSequenceLock(m_lock.get());
+	m_parameters.insert(stored->name(), std::unique_ptr<IAnyTypeParameter, ParameterDeleter>(stored, ParameterDeleter{m_resource}));
+	m_optionsDescr.reset();
+	m_optionsDescrWithGroup.reset();
+	m_revision = nextSchemaStamp();
+	return *stored;
 }
 
 void ParametersGroup::readPOVarsMap(const boost::program_options::variables_map& clOpts)
 {
-	for (auto &it : m_parameters)
+	// Options are resolved by name index of the group. Full names are applied
+	// after short ones, so they override them
+	for (bool isFull : {false, true})
 	{
-		it.second->getFromPO(clOpts, m_groupName + ".");
+		for (auto &option : clOpts)
+		{
+			std::string_view name = option.first;
+			bool hasPrefix = name.size() > m_groupName.size() && name[m_groupName.size()] == '.'
+					&& name.compare(0, m_groupName.size(), m_groupName) == 0;
+			if (hasPrefix != isFull)
+				continue;
+			IAnyTypeParameter* parameter = findParameter(isFull ? name.substr(m_groupName.size() + 1) : name);
+			if (parameter != nullptr)
+				parameter->getFromPO(option.second);
+		}
 	}
 }
 
 const boost::program_options::options_description& ParametersGroup::getOptionsDesctiption(bool groupsNeeded, bool defaultsNeeded)
 {
-	if (groupsNeeded)
-	{
-		m_optionsDescrWithGroup.reset(new boost::program_options::options_description(m_groupName.c_str()));
-		for (auto &it : m_parameters)
-			it.second->addToPO(*m_optionsDescrWithGroup, m_groupName + ".", defaultsNeeded);
-		return *m_optionsDescrWithGroup;
-	} else {
-		m_optionsDescr.reset(new boost::program_options::options_description(m_groupName.c_str()));
-		for (auto &it : m_parameters)
-			it.second->addToPO(*m_optionsDescr, "", defaultsNeeded);
-		return *m_optionsDescr;
-	}
+	std::unique_ptr<boost::program_options::options_description>& descr =
+			defaultsNeeded ? m_optionsDescrWithDefaults : (groupsNeeded ? m_optionsDescrWithGroup : m_optionsDescr);
+	if (descr && !defaultsNeeded)
+		return *descr;
+
+	descr.reset(new boost::program_options::options_description(m_groupName.c_str()));
+	const std::string prefix = groupsNeeded ? m_groupName + "." : "";
+	for (auto &it : m_parameters.records())
+		it.value->addToPO(*descr, prefix, defaultsNeeded);
+	return *descr;
 }
 
 bool ParametersGroup::readPT(const boost::property_tree::ptree& pt)
 {
-	if (pt.count(m_groupName) == 0)
+	// Group name is a key, not a path, so it may contain dots
+	auto found = pt.find(m_groupName);
+	if (found == pt.not_found())
 		return areAllInitialized();
 
-	auto& node = pt.get_child(m_groupName);
+	auto& node = found->second;
+	TraceSpan span("read property tree");
+	span.arg("group", m_groupName);
+	span.arg("parameters", m_parameters.size());
 
 	bool allInitialized = true;
-	for (auto &it : m_parameters)
+	for (auto &it : m_parameters.records())
 	{
-		allInitialized = allInitialized && it.second->getFromPT(node);
+		allInitialized = allInitialized && it.value->getFromPT(node);
 	}
 	return allInitialized;
 }
 
 void ParametersGroup::writeIniItem(std::ostream& stream)
 {
-	if (!m_description.empty())
+	std::string buffer;
+	appendIniItem(buffer);
+	stream << buffer;
+}
+
+void ParametersGroup::appendIniItem(std::string& buffer)
+{
+	if (m_description.size() != 0)
 	{
 		/// @todo Add # to every line in case of multiline
-		stream << "# " << m_description << std::endl;
+		buffer += "# ";
+		buffer += m_description.view();
+		buffer += '\n';
 	}
 
-	stream << std::endl << "[" << m_groupName << "]" << std::endl;
-	for (auto &it : m_parameters)
+	buffer += "\n[";
+	buffer += m_groupName;
+	buffer += "]\n";
+	for (auto &it : m_parameters.records())
 	{
-		it.second->writeIniItem(stream);
+		it.value->appendIniItem(buffer);
 	}
 }
 
 IAnyTypeParameter& ParametersGroup::getInterface(const std::string& name)
+{
+	IAnyTypeParameter* parameter = findParameter(name);
+	if (parameter == nullptr)
+		throw std::runtime_error(std::string("Parameter ") + name + " is not contained in group " + m_groupName);
+
+	return *parameter;
+}
+
+const IAnyTypeParameter& ParametersGroup::getInterface(const std::string& name) const
 {
 	auto it = m_parameters.find(name);
-	if (it == m_parameters.end())
+	if (it == nullptr)
 		throw std::runtime_error(std::string("Parameter ") + name + " is not contained in group " + m_groupName);
 
-	return *m_parameters[name].get();
+	return **it;
+}
+
+IAnyTypeParameter* ParametersGroup::findParameter(std::string_view name)
+{
+	auto it = m_parameters.find(name);
+	if (it == nullptr)
+		return nullptr;
+	return it->get();
 }
 
 bool ParametersGroup::areAllInitialized()
 {
-	for (auto &it : m_parameters)
+	for (auto &it : m_parameters.records())
 	{
-		if (!it.second->initialized())
+		if (!it.value->initialized())
 			return false;
 	}
 	return true;
 }
 
+void ParametersGroup::enableConcurrentReads()
+{
+	if (!m_lock)
+		m_lock.reset(new SequenceLock());
+	// Const lookups of readers do not scan unsorted tail
+	for (auto &it : m_parameters.records())
+		it.value->setSequenceLock(m_lock.get());
+}
+
 Parameters::Parameters(const char* title) :
 		m_title(title)
 {
@@ -162,66 +367,306 @@ Parameters::Parameters(const char* title) :
 
 void Parameters::addGroup(ParametersGroup&& pg)
 {
-	m_pgOwners.push_back(std::unique_ptr<ParametersGroup>(new ParametersGroup(std::move(pg))));
-	addGroup(*m_pgOwners.back());
+	m_pgOwners.push_back(std::move(pg));
+	indexGroup(m_pgOwners.back().name(), m_pgOwners.back());
 }
 
 void Parameters::addGroup(ParametersGroup& pg)
 {
-	m_groups[pg.name()] = &pg;
+	// Group of caller may be replaced and destroyed while index still has its name
+	m_groupNames.emplace_back(pg.name());
+	indexGroup(m_groupNames.back(), pg);
+}
+
+void Parameters::indexGroup(std::string_view name, ParametersGroup& pg)
+{
+	m_groups.insert(name, &pg);
+	m_groupsRevision = nextSchemaStamp();
+	if (m_concurrentReads)
+		enableConcurrentReads();
+}
+
+void Parameters::enableConcurrentReads()
+{
+	m_concurrentReads = true;
+	for (auto &g : m_groups.records())
+		g.value->enableConcurrentReads();
+}
+
+ParametersGroup& Parameters::createGroup(const char* groupName, const char* description)
+{
+	if (!m_arena)
+		m_arena.reset(new std::pmr::monotonic_buffer_resource(m_upstream));
+	std::pmr::memory_resource* arena = m_arena.get();
+	m_pgOwners.emplace_back(groupName, description, arena);
+	indexGroup(m_pgOwners.back().name(), m_pgOwners.back());
+	return m_pgOwners.back();
+}
+
+void Parameters::setMemoryResource(std::pmr::memory_resource* upstream)
+{
+	CIC_ASSERT(!m_arena, "Memory resource should be set before the first group is created");
+	m_upstream = upstream;
 }
 
 void Parameters::parseCmdline(int argc, const char* const * argv, bool useFull, bool useShort)
+{
+	storeCmdline(argc, argv, useFull, useShort);
+	applyCmdline();
+}
+
+void Parameters::storeCmdline(int argc, const char* const * argv, bool useFull, bool useShort)
 {
 	m_vm.clear();
-	rebuildOptionsDescriptions();
+	m_storedOptions.clear();
+	m_vmValid = true;
+	if (!useFull && !useShort)
+		throw std::runtime_error("Parsing cmdline impossible: at least one of useFull, useShort should be true");
+	m_cmdlineFull = useFull;
+	m_cmdlineShort = useShort;
+
+	TraceSpan span("parse command line");
+	span.arg("arguments", argc);
+	cmdlineNames();
+
+	// Stored options refer to this copy, so arguments may be freed by caller
+	size_t length = 0;
+	for (int i = 0; i < argc; i++)
+		length += strlen(argv[i]) + 1;
+	m_cmdlineText.clear();
+	m_cmdlineText.reserve(length);
+	for (int i = 0; i < argc; i++)
+	{
+		m_cmdlineText += argv[i];
+		m_cmdlineText += '\0';
+	}
+	m_cmdlineArgc = argc;
+
+	if (m_cmdlineParser == CmdlineParser::native && storeCmdlineNative(argc))
+	{
+		m_vmValid = false;
+		span.arg("parser", "native");
+		return;
+	}
+
+	m_storedOptions.clear();
+	storeCmdlineBoost(argc, argv);
+	for (auto& option : m_vm)
+		m_storedOptions.push_back(StoredOption{option.first, std::string_view(), &option.second});
+	span.arg("parser", "boost");
+}
+
+bool Parameters::storeCmdlineNative(int argc)
+{
+	// Only exact names in "--name=value", "--name value" and "--flag" forms are
+	// resolved here. Everything else is left to boost, it reports the same errors
+	// as before and guesses abbreviated names
+	std::vector<const CmdlineName*> found;
+	const char* next = m_cmdlineText.c_str();
+	next += strlen(next) + 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view argument(next);
+		next += argument.size() + 1;
+		if (argument.size() <= 2 || argument.compare(0, 2, "--") != 0)
+			return false;
+
+		size_t equals = argument.find('=');
+		std::string_view name = argument.substr(2, equals == std::string_view::npos ? std::string_view::npos : equals - 2);
+		found.clear();
+		findCmdlineNames(name, false, found);
+		if (found.size() != 1)
+			return false;
+		const IAnyTypeParameter& parameter = *found.front()->parameter;
+
+		std::string_view text;
+		if (parameter.valueType() == typeid(bool))
+		{
+			if (equals != std::string_view::npos)
+				return false;
+			text = "true";
+		} else if (equals != std::string_view::npos) {
+			text = argument.substr(equals + 1);
+		} else {
+			if (i + 1 >= argc || *next == '-')
+				return false;
+			text = next;
+			next += text.size() + 1;
+			i++;
+		}
+		if (text.empty() || !parameter.checkCmdlineValue(text))
+			return false;
+		m_storedOptions.push_back(StoredOption{name, text, nullptr});
+	}
+
+	// Repeated option is an error of boost
+	std::sort(m_storedOptions.begin(), m_storedOptions.end(),
+		[](const StoredOption& a, const StoredOption& b) { return a.name < b.name; });
+	return std::adjacent_find(m_storedOptions.begin(), m_storedOptions.end(),
+		[](const StoredOption& a, const StoredOption& b) { return a.name == b.name; }) == m_storedOptions.end();
+}
+
+void Parameters::storeCmdlineBoost(int argc, const char* const * argv)
+{
 	namespace po = boost::program_options;
+
+	// Description gets only options that arguments may refer to: boost guesses
+	// abbreviated names, so all names starting with the argument are added too.
+	// Matching, ambiguity and unknown option errors stay the same as with all options
+	std::vector<const CmdlineName*> used;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string_view argument = argv[i];
+		if (argument.size() <= 2 || argument.compare(0, 2, "--") != 0)
+			continue;
+		findCmdlineNames(argument.substr(2, argument.find('=') - 2), true, used);
+	}
+	std::sort(used.begin(), used.end(),
+		[](const CmdlineName* a, const CmdlineName* b) { return a->order < b->order; });
+	used.erase(std::unique(used.begin(), used.end()), used.end());
+
+	po::options_description options;
+	for (const CmdlineName* name : used)
+		name->parameter->addToPO(options, name->full ? name->group->name() + "." : std::string());
+
 	try
 	{
-		if (useFull && useShort)
-			po::store(po::parse_command_line(argc, argv, *m_clOptionsBoth), m_vm);
-		else if (useFull)
-			po::store(po::parse_command_line(argc, argv, *m_clOptionsWithGroups), m_vm);
-		else if (useShort)
-			po::store(po::parse_command_line(argc, argv, *m_clOptions), m_vm);
-		else
-			throw std::runtime_error("Parsing cmdline impossible: at least one of useFull, useShort should be true");
+		po::store(po::parse_command_line(argc, argv, options), m_vm);
 		po::notify(m_vm);
 	}
 	catch (po::error& e)
 	{
 		throw (std::runtime_error(std::string("Command line parsing error: ") + e.what()));
 	}
+}
 
-	for (auto it=m_groups.begin(); it!=m_groups.end(); it++)
+void Parameters::applyCmdline()
+{
+	applyStoredCmdline(nullptr);
+	commitChanges();
+}
+
+void Parameters::applyStoredCmdline(ParametersGroup* group)
+{
+	TraceSpan span("apply command line");
+	span.arg("values", m_storedOptions.size());
+	// Every option is resolved by one probe of the index and its value is
+	// applied directly, parameter given by both short and full name reads full one
+	std::vector<std::pair<const CmdlineName*, const StoredOption*>> assigned;
+	std::vector<const CmdlineName*> found;
+	cmdlineNames();
+	for (const StoredOption& option : m_storedOptions)
 	{
-		it->second->readPOVarsMap(m_vm);
+		found.clear();
+		findCmdlineNames(option.name, false, found);
+		for (const CmdlineName* name : found)
+		{
+			if (group == nullptr || name->group == group)
+				assigned.emplace_back(name, &option);
+		}
+	}
+	std::sort(assigned.begin(), assigned.end(),
+		[](const auto& a, const auto& b) {
+			if (a.first->parameter != b.first->parameter)
+				return a.first->parameter < b.first->parameter;
+			return a.first->full > b.first->full;
+		}
+	);
+	for (size_t i = 0; i < assigned.size(); i++)
+	{
+		if (i != 0 && assigned[i - 1].first->parameter == assigned[i].first->parameter)
+			continue;
+		applyStoredOption(*assigned[i].first->parameter, *assigned[i].second);
 	}
 }
 
-void Parameters::parseIni(const char* filename)
+void Parameters::applyStoredOption(IAnyTypeParameter& parameter, const StoredOption& option)
 {
-	std::string fname = SystemUtils::replaceTilta(filename);
-	try {
-		boost::property_tree::ini_parser::read_ini(fname.c_str(), m_pt);
-	}
-	catch(boost::property_tree::ini_parser::ini_parser_error &exception)
+	if (option.value != nullptr)
 	{
-		throw std::runtime_error(std::string("Parsing error in ") + exception.filename()
-				+ ":" + std::to_string(exception.line()) + " - " + exception.message());
+		parameter.getFromPO(*option.value);
+		return;
 	}
-	catch(boost::property_tree::ptree_error &exception)
+	// Value was checked by storeCmdline(), so this fails only if schema was changed since
+	if (!parameter.getFromCmdline(option.text)
+			&& (parameter.type() == ParamterType::cmdLine || parameter.type() == ParamterType::both))
 	{
-		throw std::runtime_error(std::string("Parsing error in ") + exception.what());
+		throw std::runtime_error("Command line parsing error: the argument ('" + std::string(option.text)
+				+ "') for option '--" + std::string(option.name) + "' is invalid");
 	}
-	catch(...)
+}
+
+void Parameters::parseIni(const char* filename)
+{
+	std::string fname = SystemUtils::replaceTilta(filename);
+	TraceSpan span("parseIni");
+	span.arg("file", fname);
+	BinaryImage image;
+	if (m_binaryCache && m_binaryCache->load(binarySchema(), fname, image))
 	{
-		throw std::runtime_error("Unknown parsing error");
+		TraceSpan applySpan("apply image");
+		applySpan.arg("values", image.values().size());
+		image.apply();
+	} else {
+		IniDocument ini(fname);
+		if (m_binaryCache)
+		{
+			std::vector<std::pair<IAnyTypeParameter*, std::string>> values;
+			if (readIni(ini, &values))
+				m_binaryCache->save(binarySchema(), fname, ini.stamp(), values);
+		} else {
+			readIni(ini);
+		}
 	}
-	for (auto it=m_groups.begin(); it!=m_groups.end(); it++)
+	m_ptSource = fname;
+	m_ptValid = false;
+	commitChanges();
+}
+
+bool Parameters::readIni(const IniDocument& ini, std::vector<std::pair<IAnyTypeParameter*, std::string>>* binaryValues)
+{
+	bool cacheable = true;
+	TraceSpan span("apply ini");
+	span.arg("entries", ini.entries().size());
+	// Entries of one section are always adjacent
+	size_t currentSection = 0;
+	ParametersGroup* group = nullptr;
+	for (const IniEntry& entry : ini.entries())
 	{
-		it->second->readPT(m_pt);
+		if (entry.sectionIndex != currentSection)
+		{
+			currentSection = entry.sectionIndex;
+			auto it = m_groups.find(entry.section);
+			group = it == nullptr ? nullptr : *it;
+		}
+		if (group == nullptr)
+			continue;
+
+		IAnyTypeParameter* parameter = group->findParameter(entry.key);
+		if (parameter == nullptr)
+			continue;
+
+		applyIniValue(*parameter, entry, ini);
+		if (binaryValues != nullptr && cacheable && parameter->type() != ParamterType::cmdLine)
+		{
+			// Image without this value would silently lose it on the next load
+			binaryValues->emplace_back(parameter, std::string());
+			cacheable = parameter->writeBinary(binaryValues->back().second);
+		}
 	}
+	return cacheable;
+}
+
+void Parameters::applyIniValue(IAnyTypeParameter& parameter, const IniEntry& entry, const IniDocument& ini)
+{
+	if (!parameter.getFromIni(entry.value))
+		throwIniValueError(entry, ini);
+}
+
+void Parameters::checkIniValue(const IAnyTypeParameter& parameter, const IniEntry& entry, const IniDocument& ini)
+{
+	if (!parameter.checkIniValue(entry.value))
+		throwIniValueError(entry, ini);
 }
 
 void Parameters::parseIni(const std::vector<std::string>& variants, const std::string& suffix)
@@ -233,45 +678,164 @@ void Parameters::parseIni(const std::vector<std::string>& variants, const std::s
 	parseIni(filename.c_str());
 }
 
-void Parameters::cmdlineHelp(std::ostream& stream, bool printFullForm)
+void Parameters::setBinaryCache(const std::string& directory)
 {
-	rebuildOptionsDescriptions(true);
-	if (printFullForm)
-		stream << *m_clOptionsWithGroups;
+	if (directory.empty())
+		m_binaryCache.reset();
 	else
-		stream << *m_clOptions;
+		m_binaryCache.reset(new BinaryCache(directory));
 }
 
-void Parameters::writeIni(std::ostream& stream)
+size_t Parameters::subscribe(const std::string& groupName, ChangeCallback callback)
+{
+	ParametersGroup* g = group(groupName);
+	CIC_ASSERT(g != nullptr, std::string("Group ") + groupName + " does not exist");
+	m_subscriptions.push_back(Subscription{++m_lastSubscriptionId, g, nullptr, std::move(callback)});
+	return m_lastSubscriptionId;
+}
+
+size_t Parameters::subscribe(const std::string& groupName, const std::string& name, ChangeCallback callback)
 {
-	for (auto it=m_groups.begin(); it != m_groups.end(); it++)
+	ParametersGroup* g = group(groupName);
+	CIC_ASSERT(g != nullptr, std::string("Group ") + groupName + " does not exist");
+	m_subscriptions.push_back(Subscription{++m_lastSubscriptionId, g, &g->getInterface(name), std::move(callback)});
+	return m_lastSubscriptionId;
+}
+
+void Parameters::unsubscribe(size_t id)
+{
+	m_subscriptions.erase(
+		std::remove_if(m_subscriptions.begin(), m_subscriptions.end(), [id](const Subscription& s) { return s.id == id; }),
+		m_subscriptions.end()
+	);
+}
+
+void Parameters::commitChanges()
+{
+	TraceSpan span("commit changes");
+	m_changes.clear();
+	for (auto &g : m_groups.records())
+	{
+		for (auto &p : g.value->m_parameters.records())
+		{
+			if (p.value->commitChange())
+				m_changes.add(*g.value, *p.value);
+		}
+	}
+	span.arg("changes", m_changes.changes().size());
+	if (m_changes.empty())
+		return;
+
+	// Copy allows callbacks to unsubscribe
+	std::vector<Subscription> subscriptions = m_subscriptions;
+	for (auto &s : subscriptions)
 	{
-		it->second->writeIniItem(stream);
+		bool affected = s.parameter != nullptr ? m_changes.contains(*s.parameter) : m_changes.contains(*s.group);
+		if (affected)
+			s.callback(m_changes);
 	}
 }
 
-void Parameters::writeIni(const char* filename)
+bool ChangeSet::contains(const std::string& group, const std::string& parameter) const
 {
-	std::ofstream iniFile(filename, std::ios::out);
-	writeIni(iniFile);
+	for (const Change& c : m_changes)
+	{
+		if (c.group->name() == group && c.parameter->name() == parameter)
+			return true;
+	}
+	return false;
+}
+
+void ChangeSet::clear()
+{
+	m_changes.clear();
+	m_groups.clear();
+	m_parameters.clear();
+}
+
+void ChangeSet::add(ParametersGroup& group, IAnyTypeParameter& parameter)
+{
+	m_changes.push_back(Change{&group, &parameter});
+	m_groups.insert(&group);
+	m_parameters.insert(&parameter);
+}
+
+void Parameters::cmdlineHelp(std::ostream& stream, bool printFullForm)
+{
+	// Built only here because it shows current values as defaults
+	boost::program_options::options_description help(m_title.c_str());
+	for (auto &it : m_groups.records())
+		help.add(it.value->getOptionsDesctiption(printFullForm, true));
+	stream << help;
+}
+
+void Parameters::writeIni(std::ostream& stream)
+{
+	std::string buffer;
+	appendIni(buffer);
+	stream.write(buffer.data(), buffer.size());
+}
+
+void Parameters::writeIni(const char* filename, bool atomic)
+{
+	TraceSpan span("writeIni");
+	span.arg("file", filename);
+	std::string buffer;
+	appendIni(buffer);
+	span.arg("bytes", buffer.size());
+	SystemUtils::writeFile(filename, buffer, atomic, atomic);
+}
+
+void Parameters::appendIni(std::string& buffer)
+{
+	for (auto &it : m_groups.records())
+	{
+		it.value->appendIniItem(buffer);
+	}
 }
 
 const boost::program_options::variables_map& Parameters::variablesMap()
 {
+	if (!m_vmValid)
+	{
+		// Native parser does not fill the map, the same arguments are parsed by boost
+		std::vector<const char*> argv;
+		for (const char* it = m_cmdlineText.c_str(); argv.size() < size_t(m_cmdlineArgc); it += strlen(it) + 1)
+			argv.push_back(it);
+		cmdlineNames();
+		storeCmdlineBoost(m_cmdlineArgc, argv.data());
+		m_vmValid = true;
+	}
 	return m_vm;
 }
 
 const boost::property_tree::ptree& Parameters::propertyTree()
 {
-	return m_pt;
+	if (!m_pt)
+		m_pt.reset(new boost::property_tree::ptree());
+	if (!m_ptValid)
+	{
+		TraceSpan span("build property tree");
+		IniDocument(m_ptSource).toPropertyTree(*m_pt);
+		m_ptValid = true;
+	}
+	return *m_pt;
 }
 
 ParametersGroup* Parameters::group(const std::string& groupName)
 {
 	auto it = m_groups.find(groupName);
-	if (it == m_groups.end())
+	if (it == nullptr)
+		return nullptr;
+	return *it;
+}
+
+const ParametersGroup* Parameters::group(const std::string& groupName) const
+{
+	auto it = m_groups.find(groupName);
+	if (it == nullptr)
 		return nullptr;
-	return it->second;
+	return *it;
 }
 
 ParametersGroup& Parameters::operator[](const std::string& groupName)
@@ -279,21 +843,132 @@ ParametersGroup& Parameters::operator[](const std::string& groupName)
 	return *group(groupName);
 }
 
-void Parameters::rebuildOptionsDescriptions(bool defaultsNeeded)
+const ParametersGroup& Parameters::operator[](const std::string& groupName) const
+{
+	return *group(groupName);
+}
+
+const std::vector<Parameters::CmdlineName>& Parameters::cmdlineNames()
+{
+	unsigned long revision = schemaRevision();
+	if (revision == m_cmdlineNamesRevision)
+		return m_cmdlineNames;
+
+	TraceSpan span("build command line index");
+	m_cmdlineNames.clear();
+	size_t order = 0;
+	for (auto &g : m_groups.records())
+	{
+		// Description of all options had short names of group followed by full ones
+		const std::string prefix = g.value->name() + ".";
+		for (bool full : {false, true})
+		{
+			for (auto &p : g.value->m_parameters.records())
+			{
+				ParamterType type = p.value->type();
+				if (type != ParamterType::cmdLine && type != ParamterType::both)
+					continue;
+				std::string name = full ? prefix : std::string();
+				name += p.value->name();
+				m_cmdlineNames.push_back(CmdlineName{std::move(name), order++, g.value, p.value.get(), full});
+			}
+		}
+	}
+	std::sort(m_cmdlineNames.begin(), m_cmdlineNames.end(),
+		[](const CmdlineName& a, const CmdlineName& b) {
+			if (a.name != b.name)
+				return a.name < b.name;
+			return a.order < b.order;
+		}
+	);
+	m_cmdlineNamesRevision = revision;
+	span.arg("names", m_cmdlineNames.size());
+	return m_cmdlineNames;
+}
+
+const std::unordered_map<std::string, Parameters::EnvironmentName>& Parameters::environmentNames()
 {
-	m_clOptions.reset(new boost::program_options::options_description(m_title.c_str()));
-	m_clOptionsWithGroups.reset(new boost::program_options::options_description(m_title.c_str()));
-	m_clOptionsBoth.reset(new boost::program_options::options_description());
-	for (auto &it : m_groups)
+	unsigned long revision = schemaRevision();
+	if (revision == m_environmentNamesRevision)
+		return m_environmentNames;
+
+	TraceSpan span("build environment index");
+	m_environmentNames.clear();
+	std::string name;
+	for (auto &g : m_groups.records())
 	{
-		m_clOptions->add(it.second->getOptionsDesctiption(false, defaultsNeeded));
-		m_clOptionsWithGroups->add(it.second->getOptionsDesctiption(true, defaultsNeeded));
+		for (auto &p : g.value->m_parameters.records())
+		{
+			ParamterType type = p.value->type();
+			if (type != ParamterType::iniFile && type != ParamterType::both)
+				continue;
+			name.clear();
+			SystemUtils::appendEnvironmentName(name, g.value->name());
+			name += '_';
+			SystemUtils::appendEnvironmentName(name, p.value->name());
+			auto inserted = m_environmentNames.emplace(name, EnvironmentName{g.value, p.value.get()});
+			if (!inserted.second)
+				inserted.first->second.parameter = nullptr;
+		}
+	}
+	m_environmentNamesRevision = revision;
+	span.arg("names", m_environmentNames.size());
+	return m_environmentNames;
+}
 
-		m_clOptionsBoth->add(it.second->getOptionsDesctiption(false, defaultsNeeded));
-		m_clOptionsBoth->add(it.second->getOptionsDesctiption(true, defaultsNeeded));
+void Parameters::findCmdlineNames(std::string_view name, bool prefix, std::vector<const CmdlineName*>& found)
+{
+	const std::vector<CmdlineName>& names = m_cmdlineNames;
+	auto it = std::lower_bound(names.begin(), names.end(), name,
+		[](const CmdlineName& n, std::string_view s) { return n.name < s; });
+	for (; it != names.end(); ++it)
+	{
+		if (prefix ? it->name.compare(0, name.size(), name) != 0 : it->name != name)
+			break;
+		if (it->full ? m_cmdlineFull : m_cmdlineShort)
+			found.push_back(&*it);
 	}
 }
 
+const BinaryCache::Schema& Parameters::binarySchema()
+{
+	unsigned long revision = schemaRevision();
+	if (revision == m_binarySchemaRevision)
+		return m_binarySchema;
+
+	m_binarySchema.groups.clear();
+	uint64_t h = BinaryCache::hash(std::string_view("cic-schema\0", 11));
+	for (auto &g : m_groups.records())
+	{
+		m_binarySchema.groups.emplace_back();
+		h = BinaryCache::hash(g.name, h);
+		h = BinaryCache::hash(std::string_view("\0", 1), h);
+		for (auto &p : g.value->m_parameters.records())
+		{
+			m_binarySchema.groups.back().push_back(p.value.get());
+			char type = static_cast<char>(p.value->type());
+			h = BinaryCache::hash(p.name, h);
+			h = BinaryCache::hash(std::string_view("\0", 1), h);
+			h = BinaryCache::hash(p.value->valueType().name(), h);
+			h = BinaryCache::hash(std::string_view(&type, 1), h);
+		}
+		h = BinaryCache::hash(std::string_view("\n", 1), h);
+	}
+	m_binarySchema.hash = h;
+	m_binarySchemaRevision = revision;
+	return m_binarySchema;
+}
+
+unsigned long Parameters::schemaRevision()
+{
+	// Stamps are taken from one counter, so any added group or parameter
+	// gives a value larger than all previous ones
+	unsigned long revision = m_groupsRevision;
+	for (auto &it : m_groups.records())
+		revision = std::max(revision, it.value->revision());
+	return revision;
+}
+
 void PreconfiguredOperations::addGeneralOptions(Parameters& p, const std::string& group, bool help, bool saveIni, bool loadIni)
 {
 	ParametersGroup* g = p.group(group);
@@ -314,41 +989,49 @@ bool PreconfiguredOperations::quickReadConfiguration(
 		Parameters& p,
 		const std::vector<std::string>& configFiles,
 		int argc, const char * const * argv,
-		const std::string& group
+		const std::string& group,
+		const std::string& environmentPrefix,
+		bool atomicIniSave
 )
 {
-	// Reading command line to detect help and ini options
-	p.parseCmdline(argc, argv, true, true);
-	if (p[group.c_str()].get<bool>("help"))
+	TraceSpan span("quickReadConfiguration");
+	// Command line is tokenized once, general options are needed before anything else
+	p.storeCmdline(argc, argv, true, true);
+	auto &g = p[group.c_str()];
+	p.applyStoredCmdline(&g);
+
+	if (g.get<bool>("help"))
 	{
-		p[group.c_str()].getInterface("help").markNotInitialized();
+		// Help shows values from command line as defaults
+		p.applyCmdline();
+		g.getInterface("help").markNotInitialized();
 		p.cmdlineHelp(std::cout, true);
 		return false;
 	}
 
-	// Reading first from configuration files
+	// Configuration files, than ini file from cmdline, than environment, than command line itself
+	LayeredLoader loader(p);
 	for (auto it = configFiles.begin(); it != configFiles.end(); ++it)
 	{
 		if (!SystemUtils::probeFile(SystemUtils::replaceTilta(*it)))
 			continue;
 
-		p.parseIni(it->c_str());
+		loader.addIni(*it);
 	}
 
-	auto &g = p[group.c_str()];
-
-	// Reading last ini file from cmdline
 	if (g.initialized("ini-load"))
 	{
-		p.parseIni(g.get<std::string>("ini-load").c_str());
+		loader.addIni(g.get<std::string>("ini-load"));
 	}
 
-	// Reading than command line
-	p.parseCmdline(argc, argv, true, true);
+	if (!environmentPrefix.empty())
+		loader.addEnvironment(environmentPrefix);
+	loader.addStoredCmdline();
+	loader.apply();
 
 	if (g.initialized("ini-save"))
 	{
-		p.writeIni(g.get<std::string>("ini-save").c_str());
+		p.writeIni(g.get<std::string>("ini-save").c_str(), atomicIniSave);
 	}
 	return true;
 }
@@ -376,11 +1059,28 @@ std::string SystemUtils::replaceTilta(const std::string& source)
 
 bool SystemUtils::probeFile(const std::string& file)
 {
+	TraceSpan span("probe file");
+	span.arg("file", file);
 	return boost::filesystem::exists(file);
 }
 
+void SystemUtils::appendEnvironmentName(std::string& buffer, std::string_view name)
+{
+	for (char c : name)
+	{
+		if (c >= 'a' && c <= 'z')
+			buffer += static_cast<char>(c - 'a' + 'A');
+		else if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+			buffer += c;
+		else
+			buffer += '_';
+	}
+}
+
 std::string SystemUtils::probeFiles(const std::vector<std::string>& variants, const std::string& suffix)
 {
+	TraceSpan span("probe files");
+	span.arg("variants", variants.size());
 	for (auto& it : variants)
 	{
 		std::string fullName = it + suffix;
@@ -392,3 +1092,76 @@ std::string SystemUtils::probeFiles(const std::vector<std::string>& variants, co
 	}
 	return "";
 }
+
+namespace {
+
+/// Makes rename durable. Not all file systems can sync directories, so failure is ignored
+void syncDirectory(const std::string& filename)
+{
+	std::string directory = boost::filesystem::path(filename).parent_path().string();
+	int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+	fsync(fd);
+	close(fd);
+}
+
+/// Permissions open() gives to new file with mode 0666
+mode_t defaultFileMode()
+{
+	// umask cannot be read without setting it, so it is taken once
+	static const mode_t mask = [] {
+		mode_t current = umask(022);
+		umask(current);
+		return current;
+	}();
+	return 0666 & ~mask;
+}
+
+} // namespace
+
+void SystemUtils::writeFile(const std::string& filename, std::string_view data, bool atomic, bool durable)
+{
+	// Unique temporary name, so concurrent writers of one file do not share it
+	std::string target = atomic ? filename + ".XXXXXX" : filename;
+	int fd = atomic ? mkostemp(&target[0], O_CLOEXEC) : open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (fd < 0)
+		throw std::runtime_error("Cannot open file " + target + ": " + std::strerror(errno));
+
+	// Replacement keeps permissions of existing file, e.g. 0600 of file with secrets
+	struct stat existing;
+	int error = 0;
+	if (atomic && fchmod(fd, stat(filename.c_str(), &existing) == 0 ? existing.st_mode & 07777 : defaultFileMode()) != 0)
+		error = errno;
+
+	const char* p = data.data();
+	size_t left = error == 0 ? data.size() : 0;
+	while (left != 0)
+	{
+		ssize_t written = write(fd, p, left);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			break;
+		p += written;
+		left -= written;
+	}
+	if (left != 0)
+		error = errno != 0 ? errno : EIO;
+	// Data should be on disk before rename makes it visible, otherwise crash may leave empty file
+	if (error == 0 && durable && fsync(fd) != 0)
+		error = errno;
+	if (close(fd) != 0 && error == 0)
+		error = errno;
+	if (error == 0 && atomic && std::rename(target.c_str(), filename.c_str()) != 0)
+		error = errno;
+	if (error == 0 && atomic && durable)
+		syncDirectory(filename);
+
+	if (error != 0)
+	{
+		if (atomic)
+			std::remove(target.c_str());
+		throw std::runtime_error("Cannot write file " + filename + ": " + std::strerror(error));
+	}
+}
@@ -10,20 +10,125 @@
 #define LIBHEADER_INCLUDED
 
 #include "utils.hpp"
+#include "ini-parser.hpp"
+#include "flat-index.hpp"
+#include "seqlock.hpp"
+#include "binary-cache.hpp"
+#include "trace.hpp"
 #include <boost/program_options.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <functional>
 #include <list>
 #include <memory>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory_resource>
 #include <iostream>
 
 #include <initializer_list>
+#include <limits>
+#include <typeinfo>
+#include <cstdio>
 
 #define CIC_ASSERT(condition, message) if (not (condition)) throw std::runtime_error(std::string((message)));
 
 namespace cic {
 
+/**
+ * Command line value semantic that converts tokens by StringTool<T> instead of
+ * boost::lexical_cast, so values are parsed without streams and T needs no
+ * operator>> and operator<<
+ */
+template <typename T>
+class TypedValue : public boost::program_options::value_semantic_codecvt_helper<char>,
+	public boost::program_options::typed_value_base
+{
+public:
+	TypedValue* defaultValue(const T& value)
+	{
+		m_default = value;
+		m_defaultText.clear();
+		// Help keeps precision of boost::lexical_cast, ini files get the shortest exact form
+		if constexpr (std::is_floating_point<T>::value)
+		{
+			char text[64];
+			snprintf(text, sizeof(text), "%.*Lg", std::numeric_limits<T>::max_digits10, static_cast<long double>(value));
+			m_defaultText = text;
+		} else {
+			IniTextWriter<T>::append(value, m_defaultText);
+		}
+		m_hasDefault = true;
+		return this;
+	}
+
+	std::string name() const override
+	{
+		std::string result = boost::program_options::arg;
+		if (m_hasDefault)
+			result += " (=" + m_defaultText + ")";
+		return result;
+	}
+
+	unsigned min_tokens() const override { return 1; }
+	unsigned max_tokens() const override { return 1; }
+	bool is_composing() const override { return false; }
+	bool is_required() const override { return false; }
+
+	bool apply_default(boost::any& valueStore) const override
+	{
+		if (!m_hasDefault)
+			return false;
+		valueStore = m_default;
+		return true;
+	}
+
+	void notify(const boost::any&) const override { }
+
+	const std::type_info& value_type() const override { return typeid(T); }
+
+protected:
+	void xparse(boost::any& valueStore, const std::vector<std::string>& newTokens) const override
+	{
+		boost::program_options::validators::check_first_occurrence(valueStore);
+		const std::string& token = boost::program_options::validators::get_single_string(newTokens);
+		T value;
+		if (!StringTool<T>::from_string(token, value))
+			throw boost::program_options::invalid_option_value(token);
+		valueStore = std::move(value);
+	}
+
+private:
+	T m_default{};
+	std::string m_defaultText;
+	bool m_hasDefault = false;
+};
+
+template <typename T>
+TypedValue<T>* typedValue()
+{
+	return new TypedValue<T>();
+}
+
+/// boost::property_tree translator based on StringTool<T>
+template <typename T>
+struct PropertyTreeTranslator
+{
+	typedef std::string internal_type;
+	typedef T external_type;
+
+	boost::optional<T> get_value(const std::string& text) const
+	{
+		T value;
+		if (!StringTool<T>::from_string(text, value))
+			return boost::none;
+		return value;
+	}
+};
+
 enum class ParamterType
 {
 	//disabled = 0,
@@ -32,66 +137,232 @@ enum class ParamterType
 	both    = iniFile | cmdLine
 };
 
+/**
+ * Immutable null-terminated text that is never released, so copying it is
+ * copying a pointer. Text is either borrowed string with static storage
+ * duration or process-wide copy shared by all equal interned texts
+ */
+class StaticString
+{
+public:
+	/// Interned copy of text, see intern() about memory it takes
+	StaticString(const char* text) : StaticString(intern(text)) { }
+	StaticString(const std::string& text) : StaticString(intern(text)) { }
+
+	/// Text is not copied, so it should live until program exit, e.g. string literal
+	static constexpr StaticString borrow(const char* text)
+	{
+		return StaticString(text, std::char_traits<char>::length(text));
+	}
+
+	/**
+	 * Thread safe, equal texts get the same storage. Pool is never freed, so
+	 * memory grows with every distinct text interned during process lifetime,
+	 * not with count of schemas built from the same names
+	 */
+	static StaticString intern(std::string_view text);
+
+	std::string_view view() const { return std::string_view(m_data, m_size); }
+	const char* c_str() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	constexpr StaticString(const char* data, size_t size) :
+		m_data(data), m_size(size)
+	{ }
+
+	const char* m_data;
+	size_t m_size;
+};
+
 class IAnyTypeParameter
 {
 public:
 	virtual ~IAnyTypeParameter() {}
 	virtual std::string toString() const = 0;
-	virtual const std::string& name() const = 0;
+	virtual std::string_view name() const = 0;
 	virtual void markNotInitialized() = 0;
 
 	virtual void addToPO(boost::program_options::options_description& od, const std::string& prefix = "", bool defaultsNeeded = false) const = 0;
 	virtual bool getFromPO(const boost::program_options::variables_map& clOpts, const std::string& optionalPrefix = "") = 0;
+	/**
+	 * Set value of option already matched to this parameter. Returns false
+	 * if parameter is not allowed on command line
+	 */
+	virtual bool getFromPO(const boost::program_options::variable_value& value) = 0;
 	virtual bool getFromPT(const boost::property_tree::ptree& pt) = 0;
+	/**
+	 * Set value from ini file text representation. Returns false if value
+	 * cannot be converted, parameters not allowed in ini files ignore the call
+	 */
+	virtual bool getFromIni(std::string_view value) = 0;
+	/// True if command line text converts to value of parameter, nothing is changed
+	virtual bool checkCmdlineValue(std::string_view value) const = 0;
+	/// True if getFromIni() would accept the value, nothing is changed
+	virtual bool checkIniValue(std::string_view value) const = 0;
+	/**
+	 * Set value from command line text. Returns false if value cannot be
+	 * converted or parameter is not allowed on command line
+	 */
+	virtual bool getFromCmdline(std::string_view value) = 0;
 
 	virtual void writeIniItem(std::ostream& stream) = 0;
+	/// Append ini file lines of parameter to buffer
+	virtual void appendIniItem(std::string& buffer) const = 0;
+
+	/// Append raw value to buffer, returns false if value cannot be stored this way
+	virtual bool writeBinary(std::string& buffer) const = 0;
+	/// Set value from data written by writeBinary()
+	virtual bool readBinary(std::string_view data) = 0;
+	/// Convert ini file value to the form writeBinary() gives without changing parameter
+	virtual bool convertIniToBinary(std::string_view value, std::string& buffer) const = 0;
+
+	/**
+	 * Returns true if value was set since previous call and differs from
+	 * value it had then. Values of types without operator== always differ
+	 */
+	virtual bool commitChange() = 0;
 
 	virtual bool initialized() const = 0;
 	virtual bool setByUser() const = 0;
+	virtual ParamterType type() const = 0;
+
+	/// Lock of the group taken by every write, see ParametersGroup::enableConcurrentReads()
+	virtual void setSequenceLock(SequenceLock* lock) = 0;
+	virtual const std::type_info& valueType() const = 0;
 
 	virtual IAnyTypeParameter* copy() const = 0;
+	/// Copy allocated from given resource, should be released by destroy()
+	virtual IAnyTypeParameter* copy(std::pmr::memory_resource& resource) const = 0;
+	/// Object moved to memory allocated from given resource, should be released by destroy()
+	virtual IAnyTypeParameter* move(std::pmr::memory_resource& resource) = 0;
+	/// Destroy object created by copy(resource) or move(resource)
+	virtual void destroy(std::pmr::memory_resource& resource) = 0;
 };
 
+/// True if all types are parameters, so variadic constructors do not take other arguments
+template <typename... Args>
+struct AreParameters : std::conjunction<std::is_base_of<IAnyTypeParameter, std::decay_t<Args>>...> { };
+
+template <typename T>
+class Handle;
+
 template <typename T>
 struct Parameter : public IAnyTypeParameter
 {
-	Parameter(const char* name, const char* description, T initValue, ParamterType pt = ParamterType::both) :
+	/**
+	 * Name and description given as const char* or std::string are interned,
+	 * use StaticString::borrow() to keep literals without copying. Interned
+	 * texts stay in memory until process exit, even after parameter is
+	 * destroyed, so names generated at runtime (e.g. with counters or user
+	 * input) should not be created without bound
+	 */
+	Parameter(StaticString name, StaticString description, T initValue, ParamterType pt = ParamterType::both) :
 		m_value(initValue),
 		m_name(name),
 		m_description(description),
-		m_isInitialized(true),
-		m_parType(pt)
+		m_parType(pt),
+		m_isInitialized(true)
 	{ }
 
-	Parameter(const char* name, const char* description, ParamterType pt = ParamterType::both) :
+	Parameter(StaticString name, StaticString description, ParamterType pt = ParamterType::both) :
 		m_name(name),
 		m_description(description),
-		m_isInitialized(false),
-		m_parType(pt)
+		m_parType(pt),
+		m_isInitialized(false)
 	{
 		initNoDefault();
 	}
 
+	/// Copy does not share lock of the group that stores original
+	Parameter(const Parameter& other) :
+		m_value(other.m_value),
+		m_name(other.m_name),
+		m_description(other.m_description),
+		m_parType(other.m_parType),
+		m_isInitialized(other.m_isInitialized),
+		m_setByUser(other.m_setByUser),
+		m_touched(other.m_touched),
+		m_target(other.m_target),
+		m_previous(other.m_previous)
+	{ }
+
+	Parameter(Parameter&& other) :
+		m_value(std::move(other.m_value)),
+		m_name(other.m_name),
+		m_description(other.m_description),
+		m_parType(other.m_parType),
+		m_isInitialized(other.m_isInitialized),
+		m_setByUser(other.m_setByUser),
+		m_touched(other.m_touched),
+		m_target(other.m_target),
+		m_previous(std::move(other.m_previous))
+	{ }
+
+	Parameter& operator=(const Parameter&) = delete;
+
 	T& get()
 	{
-		CIC_ASSERT(m_isInitialized, std::string("Parameter ") + m_name + " usage without initialization!");
+		CIC_ASSERT(m_isInitialized, std::string("Parameter ") + m_name.c_str() + " usage without initialization!");
 		return m_value;
 	}
 
-	const std::string& name() const override { return m_name; }
+	/**
+	 * Every value set by parsing is also written to target, so application
+	 * reads its own variable without any lookup. Current value, if any, is
+	 * written immediately. Changes made through get() are not propagated
+	 */
+	Parameter& bind(T* target)
+	{
+		m_target = target;
+		if (m_isInitialized)
+			valueChanged();
+		return *this;
+	}
+
+	const T& get() const
+	{
+		CIC_ASSERT(m_isInitialized, std::string("Parameter ") + m_name.c_str() + " usage without initialization!");
+		return m_value;
+	}
+
+	/**
+	 * Copy of value that may be taken while other thread parses configuration,
+	 * if group of parameter allows concurrent reads. See
+	 * ParametersGroup::enableConcurrentReads()
+	 */
+	T read() const
+	{
+		if (m_lock == nullptr)
+			return get();
+		if constexpr (std::is_trivially_copyable<T>::value)
+		{
+			auto [initialized, value] = m_lock->read([this] {
+				return std::make_pair(SequenceLock::load(m_isInitialized), SequenceLock::load(m_value));
+			});
+			CIC_ASSERT(initialized, std::string("Parameter ") + m_name.c_str() + " usage without initialization!");
+			return value;
+		} else {
+			std::shared_lock<std::shared_mutex> guard(m_lock->mutex());
+			return get();
+		}
+	}
+
+	std::string_view name() const override { return m_name.view(); }
 
 	std::string toString() const override
 	{
 		return StringTool<T>::to_string(m_value);
 	}
 
-	bool initialized() const override {	return m_isInitialized; }
+	bool initialized() const override { return m_isInitialized; }
 
 	void markNotInitialized() override { m_isInitialized = false; }
 
 	void addToPO(boost::program_options::options_description& od, const std::string& prefix = "", bool defaultsNeeded = false) const override;
 
 	bool getFromPO(const boost::program_options::variables_map& clOpts, const std::string& optionalPrefix = "") override;
+	bool getFromPO(const boost::program_options::variable_value& value) override;
 
 	bool getFromPT(const boost::property_tree::ptree& pt)
 	{
@@ -99,45 +370,243 @@ struct Parameter : public IAnyTypeParameter
 		{
 			if (pt.count(m_name.c_str()) != 0)
 			{
-				m_value = pt.get<T>(m_name.c_str());
-				m_setByUser = true;
-				m_isInitialized = true;
+				assign(pt.get<T>(m_name.c_str(), PropertyTreeTranslator<T>()));
 			}
 		}
 
 		return initialized();
 	}
 
+	bool getFromIni(std::string_view value) override
+	{
+		if (m_parType != ParamterType::iniFile && m_parType != ParamterType::both)
+			return true;
+
+		T converted;
+		if (!StringTool<T>::from_string(value, converted))
+			return false;
+		assign(std::move(converted));
+		return true;
+	}
+
+	bool checkCmdlineValue(std::string_view value) const override
+	{
+		T converted;
+		return StringTool<T>::from_string(value, converted);
+	}
+
+	bool checkIniValue(std::string_view value) const override
+	{
+		if (m_parType != ParamterType::iniFile && m_parType != ParamterType::both)
+			return true;
+
+		T converted;
+		return StringTool<T>::from_string(value, converted);
+	}
+
+	bool getFromCmdline(std::string_view value) override
+	{
+		if (m_parType != ParamterType::cmdLine && m_parType != ParamterType::both)
+			return false;
+
+		T converted;
+		if (!StringTool<T>::from_string(value, converted))
+			return false;
+		assign(std::move(converted));
+		return true;
+	}
+
 	void writeIniItem(std::ostream& stream) override
+	{
+		std::string buffer;
+		appendIniItem(buffer);
+		stream << buffer;
+	}
+
+	void appendIniItem(std::string& buffer) const override
 	{
 		if (m_parType != ParamterType::iniFile && m_parType != ParamterType::both)
 			return;
-		stream << "# " << m_description << std::endl;
-		stream << m_name << " = ";
+		buffer += "# ";
+		buffer += m_description.view();
+		buffer += '\n';
+		buffer += m_name.view();
+		buffer += " = ";
 		if (m_isInitialized)
-			stream << m_value << std::endl;
+			IniTextWriter<T>::append(m_value, buffer);
 		else
-			stream << "<value>" << std::endl;
+			buffer += "<value>";
+		buffer += '\n';
+	}
+
+	bool writeBinary(std::string& buffer) const override
+	{
+		if (!BinaryConverter<T>::supported || !m_isInitialized)
+			return false;
+		BinaryConverter<T>::write(m_value, buffer);
+		return true;
+	}
+
+	bool readBinary(std::string_view data) override
+	{
+		T converted;
+		if (!BinaryConverter<T>::read(data, converted))
+			return false;
+		assign(std::move(converted));
+		return true;
+	}
+
+	bool convertIniToBinary(std::string_view value, std::string& buffer) const override
+	{
+		T converted;
+		if (!BinaryConverter<T>::supported || !StringTool<T>::from_string(value, converted))
+			return false;
+		BinaryConverter<T>::write(converted, buffer);
+		return true;
 	}
 
 	bool setByUser() const override { return m_setByUser; }
 
+	bool commitChange() override
+	{
+		if (!m_touched)
+			return false;
+		m_touched = false;
+		bool changed = true;
+		if constexpr (IsEqualityComparable<T>::value)
+			changed = !m_previous || !(*m_previous == m_value);
+		m_previous.reset();
+		return changed;
+	}
+
+	ParamterType type() const override { return m_parType; }
+
+	const std::type_info& valueType() const override { return typeid(T); }
+
+	void setSequenceLock(SequenceLock* lock) override { m_lock = lock; }
+
 private:
+	friend class Handle<T>;
+
 	virtual IAnyTypeParameter* copy() const override
 	{
 		Parameter *p = new Parameter(*this);
 		return p;
 	}
 
+	IAnyTypeParameter* copy(std::pmr::memory_resource& resource) const override
+	{
+		void* memory = resource.allocate(sizeof(Parameter), alignof(Parameter));
+		return new (memory) Parameter(*this);
+	}
+
+	IAnyTypeParameter* move(std::pmr::memory_resource& resource) override
+	{
+		void* memory = resource.allocate(sizeof(Parameter), alignof(Parameter));
+		return new (memory) Parameter(std::move(*this));
+	}
+
+	void destroy(std::pmr::memory_resource& resource) override
+	{
+		this->~Parameter();
+		resource.deallocate(this, sizeof(Parameter), alignof(Parameter));
+	}
+
 	/// Function to be easy overrided for bool parameter
 	void initNoDefault();
 
+	/// Every value set by parsing goes here
+	void assign(T value)
+	{
+		SequenceLock::WriteGuard guard(m_lock);
+		if (!m_touched)
+		{
+			m_touched = true;
+			if (m_isInitialized)
+				m_previous = m_value;
+		}
+		m_setByUser = true;
+		if constexpr (std::is_trivially_copyable<T>::value)
+		{
+			if (m_lock != nullptr)
+			{
+				SequenceLock::store(m_isInitialized, true);
+				SequenceLock::store(m_value, value);
+			} else {
+				m_isInitialized = true;
+				m_value = std::move(value);
+			}
+		} else {
+			m_isInitialized = true;
+			m_value = std::move(value);
+		}
+		valueChanged();
+	}
+
+	void valueChanged()
+	{
+		if (m_target != nullptr)
+			*m_target = m_value;
+	}
+
 	T m_value;
-	std::string m_name;
-	std::string m_description;
+	StaticString m_name;
+	StaticString m_description;
+	ParamterType m_parType = ParamterType::both;
 	bool m_isInitialized;
 	bool m_setByUser = false;
-	ParamterType m_parType = ParamterType::both;
+	/// Set by assignment, cleared by commitChange()
+	bool m_touched = false;
+	SequenceLock* m_lock = nullptr;
+	T* m_target = nullptr;
+	/// Value before the first assignment since last commitChange()
+	std::optional<T> m_previous;
+};
+
+/// Parameter name and struct member for ParametersGroup::bindMembers()
+template <typename Struct, typename Field>
+struct MemberBinding
+{
+	const char* name;
+	Field Struct::* member;
+};
+
+template <typename Struct, typename Field>
+MemberBinding<Struct, Field> member(const char* name, Field Struct::* member)
+{
+	return MemberBinding<Struct, Field>{name, member};
+}
+
+/**
+ * Typed reference to a parameter value that is resolved by name only once.
+ * Reading the value is a single pointer dereference without any lookup or
+ * initialization check, so handles are intended for hot paths. Handle stays
+ * valid while the group owning the parameter exists and the parameter is not
+ * replaced by another one with the same name.
+ */
+template <typename T>
+class Handle
+{
+public:
+	Handle() = default;
+	explicit Handle(const Parameter<T>& parameter) :
+		m_value(&parameter.m_value),
+		m_parameter(&parameter)
+	{ }
+
+	const T& get() const { return *m_value; }
+	const T& operator*() const { return *m_value; }
+	const T* operator->() const { return m_value; }
+
+	bool valid() const { return m_value != nullptr; }
+	bool initialized() const { return m_parameter->initialized(); }
+
+	/// See Parameter::read()
+	T read() const { return m_parameter->read(); }
+
+private:
+	const T* m_value = nullptr;
+	const Parameter<T>* m_parameter = nullptr;
 };
 
 template<typename T>
@@ -148,10 +617,10 @@ void Parameter<T>::addToPO(boost::program_options::options_description& od, cons
 		if (m_isInitialized && defaultsNeeded)
 		{
 			od.add_options()
-				((prefix + m_name).c_str(), boost::program_options::value<T>()->default_value(m_value), m_description.c_str());
+				((prefix + m_name.c_str()).c_str(), typedValue<T>()->defaultValue(m_value), m_description.c_str());
 		} else {
 			od.add_options()
-				((prefix + m_name).c_str(), boost::program_options::value<T>(), m_description.c_str());
+				((prefix + m_name.c_str()).c_str(), typedValue<T>(), m_description.c_str());
 		}
 	}
 }
@@ -159,26 +628,23 @@ void Parameter<T>::addToPO(boost::program_options::options_description& od, cons
 template<typename T>
 bool Parameter<T>::getFromPO(const boost::program_options::variables_map& clOpts, const std::string& optionalPrefix)
 {
-	if (m_parType == ParamterType::cmdLine || m_parType == ParamterType::both)
-	{
-		auto tryName = [this, &clOpts](const std::string& name) -> bool {
-			if (clOpts.count(name.c_str()) == 0)
-			{
-				return false;
-			}
-
-			m_value = clOpts[name.c_str()].as<T>();
-			m_setByUser = true;
-			m_isInitialized = true;
-			return true;
-		};
-
-		if (!tryName(optionalPrefix + m_name))
-			tryName(m_name);
-	}
+	auto it = clOpts.find(optionalPrefix + m_name.c_str());
+	if (it == clOpts.end())
+		it = clOpts.find(m_name.c_str());
+	if (it != clOpts.end())
+		getFromPO(it->second);
 	return initialized();
 }
 
+template<typename T>
+bool Parameter<T>::getFromPO(const boost::program_options::variable_value& value)
+{
+	if (m_parType != ParamterType::cmdLine && m_parType != ParamterType::both)
+		return false;
+	assign(value.as<T>());
+	return true;
+}
+
 template<typename T>
 void Parameter<T>::initNoDefault() { }
 
@@ -186,54 +652,99 @@ template<>
 void Parameter<bool>::addToPO(boost::program_options::options_description& od, const std::string& prefix, bool defaultsNeeded) const;
 
 template<>
-bool Parameter<bool>::getFromPO(const boost::program_options::variables_map& clOpts, const std::string& optionalPrefix);
+bool Parameter<bool>::getFromPO(const boost::program_options::variable_value& value);
 
 template<>
 void Parameter<bool>::initNoDefault();
 
+/// Releases parameter copy to memory resource it was allocated from
+struct ParameterDeleter
+{
+	std::pmr::memory_resource* resource;
+
+	void operator()(IAnyTypeParameter* parameter) const { parameter->destroy(*resource); }
+};
+
 class ParametersGroup
 {
 public:
+	/// Description is interned like parameter descriptions are, see StaticString::intern()
 	ParametersGroup(const char* groupName, const char* description = "");
 
-	template <typename... Args>
-	ParametersGroup(const char* groupName, const char* description, Args... args) :
+	/**
+	 * Parameters added to the group are allocated from given resource that
+	 * should outlive the group
+	 */
+	ParametersGroup(const char* groupName, const char* description, std::pmr::memory_resource* resource);
+
+	/// Temporary parameters are moved to the group, so every one is copied to its storage only once
+	template <typename... Args, typename = std::enable_if_t<AreParameters<Args...>::value>>
+	ParametersGroup(const char* groupName, const char* description, Args&&... args) :
 		m_groupName(groupName),
 		m_description(description)
 	{
-		add(args...);
+		m_parameters.reserve(sizeof...(Args));
+		add(std::forward<Args>(args)...);
 	}
 
-	template <typename... Args>
-	ParametersGroup(const char* groupName, Args... args) :
+	template <typename... Args, typename = std::enable_if_t<AreParameters<Args...>::value>>
+	ParametersGroup(const char* groupName, Args&&... args) :
 		m_groupName(groupName)
 	{
-		add(args...);
+		m_parameters.reserve(sizeof...(Args));
+		add(std::forward<Args>(args)...);
 	}
 
 	ParametersGroup(ParametersGroup&& pg);
 	const std::string& name();
 
-	template <typename... Args>
-	void add(const IAnyTypeParameter& parameter, Args... args)
+	template <typename First, typename Second, typename... Args>
+	void add(First&& first, Second&& second, Args&&... args)
 	{
-		add(parameter);
-		add(args...);
+		add(std::forward<First>(first));
+		add(std::forward<Second>(second), std::forward<Args>(args)...);
 	}
-	void add(const IAnyTypeParameter& parameter);
+
+	template <typename T>
+	Handle<T> add(const Parameter<T>& parameter)
+	{
+		return Handle<T>(static_cast<Parameter<T>&>(add(static_cast<const IAnyTypeParameter&>(parameter))));
+	}
+
+	template <typename T>
+	Handle<T> add(Parameter<T>&& parameter)
+	{
+		return Handle<T>(static_cast<Parameter<T>&>(add(static_cast<IAnyTypeParameter&&>(parameter))));
+	}
+
+	/// Returns stored copy of parameter
+	IAnyTypeParameter& add(const IAnyTypeParameter& parameter);
+	/// Returns stored parameter, value of temporary is moved to it
+	IAnyTypeParameter& add(IAnyTypeParameter&& parameter);
 
 	void readPOVarsMap(const boost::program_options::variables_map& clOpts);
 
+	/**
+	 * Options description without defaults is cached until next parameter is added.
+	 * Description with defaults shows current values so it is rebuilt on every call
+	 */
 	const boost::program_options::options_description& getOptionsDesctiption(bool groupsNeeded, bool defaultsNeeded = false);
 
+	/// Changed every time a parameter is added, to a value no other group or Parameters had
+	unsigned long revision() const { return m_revision; }
+
 	/**
 	 * Read variables from boost::property_tree
 	 * returns false if at least one parameter in this group is not initialized yet
 	 */
 	bool readPT(const boost::property_tree::ptree& pt);
 	void writeIniItem(std::ostream& stream);
+	void appendIniItem(std::string& buffer);
 
 	IAnyTypeParameter& getInterface(const std::string& name);
+	const IAnyTypeParameter& getInterface(const std::string& name) const;
+	/// Returns nullptr if there is no such parameter
+	IAnyTypeParameter* findParameter(std::string_view name);
 
 	template <typename T>
 	const T& get(const std::string& name)
@@ -241,30 +752,114 @@ public:
 		return dynamic_cast<Parameter<T>&>(getInterface(name)).get();
 	}
 
-	bool initialized(const std::string& name)
+	template <typename T>
+	const T& get(const std::string& name) const
+	{
+		return dynamic_cast<const Parameter<T>&>(getInterface(name)).get();
+	}
+
+	/// Throws if there is no such parameter or it has other type
+	template <typename T>
+	Handle<T> handle(const std::string& name)
+	{
+		return Handle<T>(dynamic_cast<Parameter<T>&>(getInterface(name)));
+	}
+
+	/// Write values of parameter to target, see Parameter::bind(). Throws like handle() does
+	template <typename T>
+	void bind(const std::string& name, T* target)
+	{
+		dynamic_cast<Parameter<T>&>(getInterface(name)).bind(target);
+	}
+
+	/**
+	 * Bind several parameters to members of one struct:
+	 *
+	 *     g.bindMembers(config, member("k", &Config::k), member("b", &Config::b));
+	 */
+	template <typename Struct, typename... Fields>
+	void bindMembers(Struct& object, const MemberBinding<Struct, Fields>&... members)
+	{
+		(bind(members.name, &(object.*members.member)), ...);
+	}
+
+	bool initialized(const std::string& name) const
 	{
 		return getInterface(name).initialized();
 	}
 
+	/**
+	 * Allow other threads to read() values while one thread parses configuration.
+	 * Parameters should not be added after this call
+	 */
+	void enableConcurrentReads();
+
+	/// Copy of value, see Parameter::read()
+	template <typename T>
+	T read(const std::string& name) const
+	{
+		return dynamic_cast<const Parameter<T>&>(getInterface(name)).read();
+	}
+
 private:
+	friend class Parameters;
+
 	std::unique_ptr<boost::program_options::options_description> m_optionsDescr;
 	std::unique_ptr<boost::program_options::options_description> m_optionsDescrWithGroup;
+	std::unique_ptr<boost::program_options::options_description> m_optionsDescrWithDefaults;
+	unsigned long m_revision = 0;
 
 	bool areAllInitialized();
+	/// Take ownership of parameter allocated from m_resource
+	IAnyTypeParameter& store(IAnyTypeParameter* stored);
+
 	std::string m_groupName;
-	std::string m_description;
-	std::map<std::string, std::unique_ptr<IAnyTypeParameter>> m_parameters;
+	StaticString m_description = StaticString::borrow("");
+	std::pmr::memory_resource* m_resource = std::pmr::new_delete_resource();
+	std::unique_ptr<SequenceLock> m_lock;
+	FlatIndex<std::unique_ptr<IAnyTypeParameter, ParameterDeleter>> m_parameters;
+};
+
+/// Parameters which values were changed by one parse operation
+class ChangeSet
+{
+public:
+	struct Change
+	{
+		ParametersGroup* group;
+		IAnyTypeParameter* parameter;
+	};
+
+	const std::vector<Change>& changes() const { return m_changes; }
+	bool empty() const { return m_changes.empty(); }
+	bool contains(const ParametersGroup& group) const { return m_groups.count(&group) != 0; }
+	bool contains(const IAnyTypeParameter& parameter) const { return m_parameters.count(&parameter) != 0; }
+	/// False if there is no such group or parameter
+	bool contains(const std::string& group, const std::string& parameter) const;
+
+private:
+	friend class Parameters;
+
+	void clear();
+	void add(ParametersGroup& group, IAnyTypeParameter& parameter);
+
+	std::vector<Change> m_changes;
+	std::unordered_set<const ParametersGroup*> m_groups;
+	std::unordered_set<const IAnyTypeParameter*> m_parameters;
 };
 
 class Parameters
 {
 public:
+	using ChangeCallback = std::function<void(const ChangeSet&)>;
+
 	Parameters(const char* title = "Allowed options");
 
 	template <typename... Args>
 	Parameters(const char* title, Args&&... args) :
 		m_title(title)
 	{
+		m_groups.reserve(sizeof...(Args));
 		addGroup(std::forward<Args>(args)...);
 	}
 
@@ -285,38 +880,232 @@ public:
 	void addGroup(ParametersGroup&& pg);
 	void addGroup(ParametersGroup& pg);
 
+	/**
+	 * Create empty group owned by Parameters. Parameters added to it are
+	 * carved from an arena of large blocks that is released at once with
+	 * Parameters, so building big schemas this way avoids per-parameter
+	 * heap allocations. The group should not be moved out of Parameters
+	 */
+	ParametersGroup& createGroup(const char* groupName, const char* description = "");
+
+	/**
+	 * Upstream resource for arena blocks, new_delete_resource() by default.
+	 * Should be set before the first createGroup() call
+	 */
+	void setMemoryResource(std::pmr::memory_resource* upstream);
+
+	/**
+	 * Allow other threads to read() values while one thread parses
+	 * configuration into this object. Every write of a value is done under
+	 * sequence lock of its group: trivially copyable values are read without
+	 * blocking and retried on conflict, others are read under shared lock.
+	 * Groups added later allow concurrent reads too. Only read() of
+	 * parameters, handles and groups and const lookups are safe during parse,
+	 * bound variables are written without lock
+	 */
+	void enableConcurrentReads();
+
+	/**
+	 * Command line is parsed by built-in parser in one pass over arguments.
+	 * Arguments it does not resolve on its own (abbreviated or ambiguous
+	 * names, values starting with '-', positional arguments, repeated options,
+	 * values that cannot be converted) are parsed by boost::program_options,
+	 * so accepted syntax and errors are the same as with boost
+	 */
 	void parseCmdline(int argc, const char * const * argv, bool useFull = true, bool useShort = true);
+	/// Parse command line into variablesMap() without changing parameters values
+	void storeCmdline(int argc, const char * const * argv, bool useFull = true, bool useShort = true);
+	/// Set parameters from command line stored by last storeCmdline() call
+	void applyCmdline();
+
+	enum class CmdlineParser
+	{
+		/// Built-in parser falling back to boost
+		native,
+		boost
+	};
+	void setCmdlineParser(CmdlineParser parser) { m_cmdlineParser = parser; }
+
 	void parseIni(const char* filename);
 	void parseIni(const std::vector<std::string>& variants, const std::string& suffix = "");
 
+	/**
+	 * Keep compiled images of parsed ini files in given directory and load
+	 * values from them while both file and schema are not changed.
+	 * Empty string disables the cache
+	 */
+	void setBinaryCache(const std::string& directory);
+	/// Schema to check and apply images of BinaryCache with, rebuilt only when schema changes
+	const BinaryCache::Schema& binarySchema();
+
 	void cmdlineHelp(std::ostream& stream, bool printFullForm = false);
+	/// Ini file text is formatted into one buffer and written at once
 	void writeIni(std::ostream& stream);
-	void writeIni(const char* filename);
+	/**
+	 * Write ini file with single write call, throws std::runtime_error on failure.
+	 * In atomic mode text is written to temporary file that replaces target,
+	 * so readers never see partially written file
+	 */
+	void writeIni(const char* filename, bool atomic = false);
+	/// Append ini file text to buffer
+	void appendIni(std::string& buffer);
 
+	/// Options of last storeCmdline() call, built by boost on first request after native parsing
 	const boost::program_options::variables_map& variablesMap();
 	const boost::property_tree::ptree& propertyTree();
 
 	ParametersGroup* group(const std::string& groupName);
+	const ParametersGroup* group(const std::string& groupName) const;
 	ParametersGroup& operator[](const std::string& groupName);
+	const ParametersGroup& operator[](const std::string& groupName) const;
+
+	/**
+	 * Callback is called once after every parse operation (parseIni(),
+	 * parseCmdline(), applyCmdline(), quickReadConfiguration()) that changed
+	 * any parameter of the group. Throws if there is no such group.
+	 * Returns id for unsubscribe()
+	 */
+	size_t subscribe(const std::string& groupName, ChangeCallback callback);
+	/// The same for one parameter, throws if there is no such parameter
+	size_t subscribe(const std::string& groupName, const std::string& name, ChangeCallback callback);
+	void unsubscribe(size_t id);
+
+	/// Changes made by last parse operation
+	const ChangeSet& lastChanges() const { return m_changes; }
+
+	/// Throws if there is no such group or parameter or parameter has other type
+	template <typename T>
+	Handle<T> handle(const std::string& groupName, const std::string& name)
+	{
+		ParametersGroup* g = group(groupName);
+		CIC_ASSERT(g != nullptr, std::string("Group ") + groupName + " does not exist");
+		return g->handle<T>(name);
+	}
 
 private:
-	void rebuildOptionsDescriptions(bool defaultsNeeded = false);
-
-	std::string m_title;
-	std::list<std::unique_ptr<ParametersGroup>> m_pgOwners;
-	std::map<std::string, ParametersGroup*> m_groups;
-	std::unique_ptr<boost::program_options::options_description> m_clOptions;
-	std::unique_ptr<boost::program_options::options_description> m_clOptionsWithGroups;
-	std::unique_ptr<boost::program_options::options_description> m_clOptionsBoth;
+	friend class LayeredLoader;
+	friend class PreconfiguredOperations;
+
+	/// Name accepted on command line, short or prefixed with group name
+	struct CmdlineName
+	{
+		std::string name;
+		/// Position of option in description of all groups, boost reports matches in this order
+		size_t order;
+		ParametersGroup* group;
+		IAnyTypeParameter* parameter;
+		bool full;
+	};
+
+	/// Sorted names of all command line parameters, rebuilt only when groups or parameters are added
+	const std::vector<CmdlineName>& cmdlineNames();
+	/**
+	 * Append entries allowed by last storeCmdline() call that have given name
+	 * or, if prefix is true, start with it. Index should be updated by cmdlineNames()
+	 */
+	void findCmdlineNames(std::string_view name, bool prefix, std::vector<const CmdlineName*>& found);
+
+	/// Option given by last storeCmdline() call
+	struct StoredOption
+	{
+		std::string_view name;
+		/// Text of value for native parser, "true" for flags
+		std::string_view text;
+		/// Value parsed by boost, nullptr if native parser was used
+		const boost::program_options::variable_value* value;
+	};
+
+	/// Returns false if arguments should be parsed by boost
+	bool storeCmdlineNative(int argc);
+	void storeCmdlineBoost(int argc, const char * const * argv);
+	/// Set parameters of group or of all groups if group is nullptr from stored options
+	void applyStoredCmdline(ParametersGroup* group);
+	static void applyStoredOption(IAnyTypeParameter& parameter, const StoredOption& option);
+
+	/// Parameter found by name of environment variable, parameter is nullptr if name is ambiguous
+	struct EnvironmentName
+	{
+		ParametersGroup* group;
+		IAnyTypeParameter* parameter;
+	};
+
+	/**
+	 * Parameters allowed in ini files by names of environment variables
+	 * without prefix, like GROUP_PARAM. Rebuilt only when schema changes
+	 */
+	const std::unordered_map<std::string, EnvironmentName>& environmentNames();
+	unsigned long schemaRevision();
+	/**
+	 * If binaryValues is given, it gets values of assigned parameters for binary cache.
+	 * Returns false if some assigned value has no binary form, image should not be saved then
+	 */
+	bool readIni(const IniDocument& ini, std::vector<std::pair<IAnyTypeParameter*, std::string>>* binaryValues = nullptr);
+	/// Name should live as long as Parameters do
+	void indexGroup(std::string_view name, ParametersGroup& pg);
+	static void applyIniValue(IAnyTypeParameter& parameter, const IniEntry& entry, const IniDocument& ini);
+	/// Throws the same error as applyIniValue() does, but parameter is not changed
+	static void checkIniValue(const IAnyTypeParameter& parameter, const IniEntry& entry, const IniDocument& ini);
+	/// Collect changes made since previous call and notify subscribers
+	void commitChanges();
+
+	struct Subscription
+	{
+		size_t id;
+		const ParametersGroup* group;
+		/// nullptr for whole group
+		const IAnyTypeParameter* parameter;
+		ChangeCallback callback;
+	};
+
+	StaticString m_title;
+	/// Declared before groups because they release parameters to it
+	std::pmr::memory_resource* m_upstream = std::pmr::new_delete_resource();
+	bool m_concurrentReads = false;
+	std::unique_ptr<std::pmr::monotonic_buffer_resource> m_arena;
+	std::list<ParametersGroup> m_pgOwners;
+	/// Names of groups added by reference, index points here
+	std::list<std::string> m_groupNames;
+	FlatIndex<ParametersGroup*> m_groups;
+	std::vector<CmdlineName> m_cmdlineNames;
+	unsigned long m_cmdlineNamesRevision = static_cast<unsigned long>(-1);
+	std::unordered_map<std::string, EnvironmentName> m_environmentNames;
+	unsigned long m_environmentNamesRevision = static_cast<unsigned long>(-1);
+	bool m_cmdlineFull = true;
+	bool m_cmdlineShort = true;
+	CmdlineParser m_cmdlineParser = CmdlineParser::native;
+	/// Arguments of last storeCmdline() call separated by '\0', stored options point here
+	std::string m_cmdlineText;
+	int m_cmdlineArgc = 0;
+	std::vector<StoredOption> m_storedOptions;
+	bool m_vmValid = true;
+	unsigned long m_groupsRevision = 0;
+	std::unique_ptr<BinaryCache> m_binaryCache;
+	BinaryCache::Schema m_binarySchema;
+	unsigned long m_binarySchemaRevision = static_cast<unsigned long>(-1);
 	boost::program_options::variables_map m_vm;
-	boost::property_tree::ptree m_pt;
+	ChangeSet m_changes;
+	std::vector<Subscription> m_subscriptions;
+	size_t m_lastSubscriptionId = 0;
+
+	/// Property tree is built from last parsed ini file only on demand
+	std::unique_ptr<boost::property_tree::ptree> m_pt;
+	std::string m_ptSource;
+	bool m_ptValid = true;
 };
 
 class PreconfiguredOperations
 {
 public:
 	static void addGeneralOptions(Parameters& p, const std::string& group = "General", bool help = true, bool saveIni = true, bool loadIni = true);
-	static bool quickReadConfiguration(Parameters& p, const std::vector<std::string>& configFiles, int argc, const char * const * argv, const std::string& group = "General");
+	/**
+	 * Configuration files, ini file given by ini-load option, environment
+	 * variables with given prefix (see LayeredLoader::addEnvironment()) if
+	 * prefix is not empty and command line, each one overrides previous ones.
+	 * File given by ini-save option is rewritten in place unless atomicIniSave
+	 * is set, see SystemUtils::writeFile()
+	 */
+	static bool quickReadConfiguration(Parameters& p, const std::vector<std::string>& configFiles, int argc, const char * const * argv,
+			const std::string& group = "General", const std::string& environmentPrefix = "", bool atomicIniSave = false);
 };
 
 class SystemUtils
@@ -325,7 +1114,17 @@ public:
 	static std::string homeDir();
 	static std::string replaceTilta(const std::string& source);
 	static bool probeFile(const std::string& file);
+	/// Upper case name where every character other than letter or digit is replaced by '_'
+	static void appendEnvironmentName(std::string& buffer, std::string_view name);
 	static std::string probeFiles(const std::vector<std::string>& variants, const std::string& suffix = "");
+	/**
+	 * Write whole file with one call, throws std::runtime_error on failure.
+	 * Atomic mode writes uniquely named temporary file in the same directory
+	 * and renames it; permissions of replaced file are kept. Rename replaces
+	 * symbolic link itself and needs writable directory. Durable mode syncs
+	 * file and, after rename, its directory to disk
+	 */
+	static void writeFile(const std::string& filename, std::string_view data, bool atomic, bool durable);
 };
 
 } // namespace cic
@@ -0,0 +1,116 @@
+/*
+ * flat-index.hpp
+ *
+ * Contiguous name -> value index used instead of std::map for groups and
+ * parameters lookup.
+ */
+
+#ifndef CIC_FLAT_INDEX_HPP_
+#define CIC_FLAT_INDEX_HPP_
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+namespace cic {
+
+/**
+ * Sorted vector of records with lookup by std::string_view. Names are not
+ * owned and should point to storage that lives as long as the record does.
+ *
+ * New records are appended to unsorted tail that is merged into the sorted
+ * part by the next non-const operation, so filling the index costs
+ * O(n log n) in total. Const lookups never modify the index and scan the
+ * tail linearly. Inserting existing name replaces old record like
+ * std::map::operator[] does.
+ */
+template <typename Value>
+class FlatIndex
+{
+public:
+	struct Record
+	{
+		std::string_view name;
+		Value value;
+	};
+
+	/// Returned reference is valid until next insertion
+	Value& insert(std::string_view name, Value value)
+	{
+		m_records.push_back(Record{name, std::move(value)});
+		return m_records.back().value;
+	}
+
+	Value* find(std::string_view name)
+	{
+		sort();
+		auto it = lowerBound(m_records.begin(), m_records.end(), name);
+		if (it == m_records.end() || it->name != name)
+			return nullptr;
+		return &it->value;
+	}
+
+	const Value* find(std::string_view name) const
+	{
+		for (auto it = m_records.rbegin(); it != m_records.rend() - m_sortedCount; ++it)
+		{
+			if (it->name == name)
+				return &it->value;
+		}
+		auto end = m_records.begin() + m_sortedCount;
+		auto it = lowerBound(m_records.begin(), end, name);
+		if (it == end || it->name != name)
+			return nullptr;
+		return &it->value;
+	}
+
+	/// All records ordered by name
+	std::vector<Record>& records()
+	{
+		sort();
+		return m_records;
+	}
+
+	size_t size() const { return m_records.size(); }
+	void reserve(size_t size) { m_records.reserve(size); }
+
+private:
+	template <typename Iterator>
+	static Iterator lowerBound(Iterator begin, Iterator end, std::string_view name)
+	{
+		return std::lower_bound(begin, end, name,
+			[](const Record& r, std::string_view n) { return r.name < n; });
+	}
+
+	void sort()
+	{
+		if (m_sortedCount == m_records.size())
+			return;
+
+		auto less = [](const Record& a, const Record& b) { return a.name < b.name; };
+		auto middle = m_records.begin() + m_sortedCount;
+		std::stable_sort(middle, m_records.end(), less);
+		std::inplace_merge(m_records.begin(), middle, m_records.end(), less);
+
+		// Among records with equal names the last inserted one is kept
+		auto kept = m_records.begin();
+		for (auto it = m_records.begin(); it != m_records.end(); ++it)
+		{
+			auto next = it + 1;
+			if (next != m_records.end() && next->name == it->name)
+				continue;
+			if (kept != it)
+				*kept = std::move(*it);
+			++kept;
+		}
+		m_records.erase(kept, m_records.end());
+		m_sortedCount = m_records.size();
+	}
+
+	std::vector<Record> m_records;
+	size_t m_sortedCount = 0;
+};
+
+} // namespace cic
+
+#endif /* CIC_FLAT_INDEX_HPP_ */
@@ -0,0 +1,215 @@
+/*
+ * generated-schema.hpp
+ *
+ * Tables and loader for schemas compiled by cic-schema-gen. Generated code
+ * has a plain struct of values and constant name tables, so nothing is
+ * registered at startup.
+ */
+
+#ifndef CIC_GENERATED_SCHEMA_HPP_
+#define CIC_GENERATED_SCHEMA_HPP_
+
+#include "cic.hpp"
+#include "ini-parser.hpp"
+#include "perfect-hash.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cic {
+
+/**
+ * Name tables of generated struct Config. Every name is found by one hash
+ * and one comparison with the name stored in its slot
+ */
+template <typename Config>
+struct GeneratedSchema
+{
+	struct Field
+	{
+		std::string_view group;
+		std::string_view name;
+		ParamterType type;
+		/// Field of bool type, on command line it is given without value
+		bool flag;
+		/// Field has no default value and should be given
+		bool required;
+		/// Returns false if text cannot be converted, field is not changed then
+		bool (*assign)(Config& config, std::string_view text);
+	};
+
+	/// Name accepted on command line, short or prefixed with group name
+	struct CmdlineName
+	{
+		std::string_view name;
+		uint32_t field;
+		bool full;
+		/// Name of several parameters, e.g. short name of parameters of several groups
+		bool ambiguous;
+	};
+
+	const Field* fields;
+	uint32_t fieldsCount;
+	/// Index of field in every slot of ini hash
+	PerfectHash ini;
+	const uint32_t* iniFields;
+	PerfectHash cmdline;
+	const CmdlineName* cmdlineNames;
+
+	/// Returns nullptr if there is no such parameter in ini files
+	const Field* findIni(std::string_view group, std::string_view name) const
+	{
+		if (ini.size() == 0)
+			return nullptr;
+		const Field& field = fields[iniFields[ini.slot(group, name)]];
+		return field.group == group && field.name == name ? &field : nullptr;
+	}
+
+	const CmdlineName* findCmdline(std::string_view name) const
+	{
+		if (cmdline.size() == 0)
+			return nullptr;
+		const CmdlineName& found = cmdlineNames[cmdline.slot(name)];
+		return found.name == name ? &found : nullptr;
+	}
+
+	/// Conversion used by generated assign functions
+	template <typename T>
+	static bool convert(std::string_view text, T& field)
+	{
+		T value;
+		if (!StringTool<T>::from_string(text, value))
+			return false;
+		field = std::move(value);
+		return true;
+	}
+};
+
+/**
+ * Reads ini files and command line into generated struct. Syntax and error
+ * messages are the same as Parameters have, but abbreviated option names
+ * are not guessed
+ */
+template <typename Config>
+class GeneratedLoader
+{
+public:
+	GeneratedLoader(const GeneratedSchema<Config>& schema, Config& config) :
+		m_schema(schema), m_config(config), m_given(schema.fieldsCount, false)
+	{
+	}
+
+	/// Unknown keys are ignored. If any value cannot be converted, config is not changed
+	void parseIni(const std::string& filename)
+	{
+		IniDocument ini(SystemUtils::replaceTilta(filename));
+		Config converted = m_config;
+		std::vector<uint32_t> given;
+		for (const IniEntry& entry : ini.entries())
+		{
+			const auto* field = m_schema.findIni(entry.section, entry.key);
+			if (field == nullptr)
+				continue;
+			if (!field->assign(converted, entry.value))
+			{
+				throw std::runtime_error(std::string("Parsing error in ") + ini.filename()
+						+ ":" + std::to_string(entry.line) + " - conversion of value '"
+						+ std::string(entry.value) + "' failed");
+			}
+			given.push_back(field - m_schema.fields);
+		}
+		m_config = std::move(converted);
+		for (uint32_t field : given)
+			m_given[field] = true;
+	}
+
+	/**
+	 * Accepts "--name=value", "--name value", "--flag" and "--" that ends
+	 * options. Short name is overridden by full name of the same parameter.
+	 * If any value cannot be converted, config is not changed
+	 */
+	void parseCmdline(int argc, const char* const* argv)
+	{
+		std::vector<std::pair<const typename GeneratedSchema<Config>::CmdlineName*, std::string_view>> options;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string_view argument = argv[i];
+			if (argument == "--")
+			{
+				if (i + 1 < argc)
+					error("too many positional options have been specified on the command line");
+				break;
+			}
+			if (argument.size() <= 2 || argument.compare(0, 2, "--") != 0)
+				error("too many positional options have been specified on the command line");
+
+			size_t equals = argument.find('=');
+			std::string_view name = argument.substr(2, equals == std::string_view::npos ? std::string_view::npos : equals - 2);
+			const auto* option = m_schema.findCmdline(name);
+			if (option == nullptr)
+				error("unrecognised option '" + std::string(argument) + "'");
+			if (option->ambiguous)
+				error("option '" + std::string(name) + "' is ambiguous");
+			for (auto& it : options)
+			{
+				if (it.first == option)
+					error("option '" + std::string(name) + "' cannot be specified more than once");
+			}
+
+			std::string_view text;
+			if (m_schema.fields[option->field].flag)
+			{
+				if (equals != std::string_view::npos)
+					error("option '" + std::string(name) + "' does not take any arguments");
+				text = "true";
+			} else if (equals != std::string_view::npos) {
+				text = argument.substr(equals + 1);
+			} else if (i + 1 < argc && argv[i + 1][0] != '-') {
+				text = argv[++i];
+			} else {
+				error("the required argument for option '--" + std::string(name) + "' is missing");
+			}
+			options.emplace_back(option, text);
+		}
+
+		Config converted = m_config;
+		for (bool full : {false, true})
+		{
+			for (auto& it : options)
+			{
+				if (it.first->full == full && !m_schema.fields[it.first->field].assign(converted, it.second))
+					error("the argument ('" + std::string(it.second) + "') for option '--" + std::string(it.first->name) + "' is invalid");
+			}
+		}
+		m_config = std::move(converted);
+		for (auto& it : options)
+			m_given[it.first->field] = true;
+	}
+
+	/// True if every field without default value was given
+	bool initialized() const
+	{
+		for (uint32_t i = 0; i < m_schema.fieldsCount; i++)
+		{
+			if (m_schema.fields[i].required && !m_given[i])
+				return false;
+		}
+		return true;
+	}
+
+private:
+	[[noreturn]] static void error(const std::string& message)
+	{
+		throw std::runtime_error("Command line parsing error: " + message);
+	}
+
+	const GeneratedSchema<Config>& m_schema;
+	Config& m_config;
+	std::vector<bool> m_given;
+};
+
+} // namespace cic
+
+#endif /* CIC_GENERATED_SCHEMA_HPP_ */
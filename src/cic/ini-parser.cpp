@@ -0,0 +1,265 @@
+#include "ini-parser.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace cic;
+
+namespace {
+
+inline bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+std::string_view trim(std::string_view s)
+{
+	size_t begin = 0;
+	while (begin < s.size() && isSpace(s[begin]))
+		begin++;
+	size_t end = s.size();
+	while (end > begin && isSpace(s[end - 1]))
+		end--;
+	return s.substr(begin, end - begin);
+}
+
+void fillStamp(const struct stat& st, FileStamp& stamp)
+{
+	stamp.size = st.st_size;
+	stamp.mtimeSec = st.st_mtim.tv_sec;
+	stamp.mtimeNsec = st.st_mtim.tv_nsec;
+	stamp.inode = st.st_ino;
+	stamp.device = st.st_dev;
+}
+
+} // namespace
+
+bool FileStamp::ofFile(const std::string& filename, FileStamp& stamp)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return false;
+	fillStamp(st, stamp);
+	return true;
+}
+
+MappedFile::MappedFile(const std::string& filename)
+{
+	int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error("cannot open file");
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("cannot get file size");
+	}
+	fillStamp(st, m_stamp);
+
+	if (st.st_size != 0)
+	{
+		void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close(fd);
+			throw std::runtime_error("cannot map file");
+		}
+		madvise(data, st.st_size, MADV_SEQUENTIAL);
+		m_data = static_cast<const char*>(data);
+		m_size = st.st_size;
+	}
+	close(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+		m_data(other.m_data),
+		m_size(other.m_size),
+		m_stamp(other.m_stamp)
+{
+	other.m_data = nullptr;
+	other.m_size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		unmap();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+		std::swap(m_stamp, other.m_stamp);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	unmap();
+}
+
+void MappedFile::unmap()
+{
+	if (m_data != nullptr)
+		munmap(const_cast<char*>(m_data), m_size);
+	m_data = nullptr;
+	m_size = 0;
+}
+
+IniDocument::IniDocument(const std::string& filename) :
+		m_filename(filename)
+{
+	TraceSpan span("tokenize ini");
+	span.arg("file", filename);
+	try {
+		m_file = MappedFile(filename);
+	}
+	catch (std::runtime_error& ex)
+	{
+		error(ex.what(), 0);
+	}
+	tokenize();
+	span.arg("bytes", m_file.text().size());
+	span.arg("entries", m_entries.size());
+}
+
+void IniDocument::toPropertyTree(boost::property_tree::ptree& pt) const
+{
+	using boost::property_tree::ptree;
+	ptree local;
+	ptree* section = nullptr;
+	size_t currentSection = 0;
+	for (const IniEntry& entry : m_entries)
+	{
+		if (entry.sectionIndex == 0)
+		{
+			local.push_back(std::make_pair(std::string(entry.key), ptree(std::string(entry.value))));
+			continue;
+		}
+		if (section == nullptr || entry.sectionIndex != currentSection)
+		{
+			section = &local.push_back(std::make_pair(std::string(entry.section), ptree()))->second;
+			currentSection = entry.sectionIndex;
+		}
+		section->push_back(std::make_pair(std::string(entry.key), ptree(std::string(entry.value))));
+	}
+	pt.swap(local);
+}
+
+void IniDocument::tokenize()
+{
+	std::string_view text = m_file.text();
+	// UTF-8 byte order mark is not a part of the first line
+	if (text.size() >= 3 && text.compare(0, 3, "\xEF\xBB\xBF") == 0)
+		text.remove_prefix(3);
+
+	// Sections that have entries and root keys share one namespace
+	std::unordered_set<std::string_view> usedSections;
+	std::string_view section;
+	size_t sectionIndex = 0;
+	bool sectionEmpty = true;
+
+	// Keys of section are checked before anything that follows them, so the
+	// first error of the file is reported like a sequential reader does
+	size_t sectionStart = 0;
+	std::vector<const IniEntry*> sorted;
+	auto fail = [this, &sectionStart, &sorted](const char* message, size_t line) {
+		checkDuplicatedKeys(sectionStart, sorted);
+		error(message, line);
+	};
+
+	size_t lineNumber = 0;
+	size_t pos = 0;
+	while (pos < text.size())
+	{
+		lineNumber++;
+		const char* lineEnd = static_cast<const char*>(memchr(text.data() + pos, '\n', text.size() - pos));
+		size_t end = lineEnd ? lineEnd - text.data() : text.size();
+		std::string_view line = trim(text.substr(pos, end - pos));
+		pos = end + 1;
+
+		if (line.empty() || line[0] == ';' || line[0] == '#')
+			continue;
+
+		if (line[0] == '[')
+		{
+			checkDuplicatedKeys(sectionStart, sorted);
+			sectionStart = m_entries.size();
+			size_t close = line.find(']');
+			if (close == std::string_view::npos)
+				error("unmatched '['", lineNumber);
+			if (sectionIndex != 0 && !sectionEmpty)
+				usedSections.insert(section);
+			section = trim(line.substr(1, close - 1));
+			if (usedSections.count(section) != 0)
+				error("duplicate section name", lineNumber);
+			sectionIndex++;
+			sectionEmpty = true;
+			continue;
+		}
+
+		size_t eqpos = line.find('=');
+		if (eqpos == std::string_view::npos)
+			fail("'=' character not found in line", lineNumber);
+		if (eqpos == 0)
+			fail("key expected", lineNumber);
+
+		IniEntry entry;
+		entry.section = section;
+		entry.key = trim(line.substr(0, eqpos));
+		entry.value = trim(line.substr(eqpos + 1));
+		entry.line = lineNumber;
+		entry.sectionIndex = sectionIndex;
+		m_entries.push_back(entry);
+
+		if (sectionIndex == 0)
+			usedSections.insert(entry.key);
+		sectionEmpty = false;
+	}
+	checkDuplicatedKeys(sectionStart, sorted);
+}
+
+void IniDocument::checkDuplicatedKeys(size_t firstEntry, std::vector<const IniEntry*>& sorted) const
+{
+	if (m_entries.size() < firstEntry + 2)
+		return;
+
+	sorted.clear();
+	for (size_t i = firstEntry; i < m_entries.size(); i++)
+		sorted.push_back(&m_entries[i]);
+
+	std::sort(sorted.begin(), sorted.end(),
+		[](const IniEntry* a, const IniEntry* b) {
+			if (a->key != b->key)
+				return a->key < b->key;
+			return a->line < b->line;
+		}
+	);
+
+	// Report the same line as a sequential reader would stop at
+	size_t firstDuplicate = 0;
+	for (size_t i = 1; i < sorted.size(); i++)
+	{
+		if (sorted[i]->key == sorted[i-1]->key)
+		{
+			if (firstDuplicate == 0 || sorted[i]->line < firstDuplicate)
+				firstDuplicate = sorted[i]->line;
+		}
+	}
+	if (firstDuplicate != 0)
+		error("duplicate key name", firstDuplicate);
+}
+
+void IniDocument::error(const std::string& message, size_t line) const
+{
+	throw std::runtime_error(std::string("Parsing error in ") + m_filename
+			+ ":" + std::to_string(line) + " - " + message);
+}
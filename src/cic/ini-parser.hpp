@@ -0,0 +1,112 @@
+/*
+ * ini-parser.hpp
+ *
+ * Native ini-file reader: the file is memory-mapped and tokenized into
+ * string_views pointing directly into the mapping, so no intermediate
+ * tree of heap-allocated strings is built.
+ */
+
+#ifndef CIC_INI_PARSER_HPP_
+#define CIC_INI_PARSER_HPP_
+
+#include <boost/property_tree/ptree.hpp>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace cic {
+
+/**
+ * Identity of file contents: if any field changes, file was modified
+ */
+struct FileStamp
+{
+	uint64_t size = 0;
+	int64_t mtimeSec = 0;
+	int64_t mtimeNsec = 0;
+	uint64_t inode = 0;
+	uint64_t device = 0;
+
+	/// Returns false if file does not exist
+	static bool ofFile(const std::string& filename, FileStamp& stamp);
+
+	bool operator==(const FileStamp& other) const
+	{
+		return size == other.size && mtimeSec == other.mtimeSec && mtimeNsec == other.mtimeNsec
+				&& inode == other.inode && device == other.device;
+	}
+};
+
+/**
+ * Read-only memory mapping of a whole file
+ */
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	/// Throws std::runtime_error if file cannot be opened or mapped
+	explicit MappedFile(const std::string& filename);
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	std::string_view text() const { return std::string_view(m_data, m_size); }
+	/// State of file at the moment it was opened
+	const FileStamp& stamp() const { return m_stamp; }
+
+private:
+	void unmap();
+
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+	FileStamp m_stamp;
+};
+
+struct IniEntry
+{
+	/// Empty for keys placed before the first section
+	std::string_view section;
+	std::string_view key;
+	std::string_view value;
+	size_t line;
+	/// Number of section in file order, 0 for keys before the first section
+	size_t sectionIndex;
+};
+
+/**
+ * Tokenized ini file. All entries point into the mapped file and stay valid
+ * while the document exists. Syntax is the same as accepted by
+ * boost::property_tree::ini_parser, including its error messages.
+ */
+class IniDocument
+{
+public:
+	/// Throws std::runtime_error with file name and line on any format violation
+	explicit IniDocument(const std::string& filename);
+
+	const std::string& filename() const { return m_filename; }
+	const std::vector<IniEntry>& entries() const { return m_entries; }
+	const FileStamp& stamp() const { return m_file.stamp(); }
+
+	/// Build property tree with the same layout as ini_parser::read_ini gives
+	void toPropertyTree(boost::property_tree::ptree& pt) const;
+
+private:
+	void tokenize();
+	/// Throws for the first repeated key of entries starting at given one, they should be of one section
+	void checkDuplicatedKeys(size_t firstEntry, std::vector<const IniEntry*>& sorted) const;
+	[[noreturn]] void error(const std::string& message, size_t line) const;
+
+	std::string m_filename;
+	MappedFile m_file;
+	std::vector<IniEntry> m_entries;
+};
+
+} // namespace cic
+
+#endif /* CIC_INI_PARSER_HPP_ */
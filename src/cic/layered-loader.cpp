@@ -0,0 +1,251 @@
+#include "layered-loader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace cic;
+
+LayeredLoader::LayeredLoader(Parameters& parameters) :
+		m_parameters(parameters)
+{
+}
+
+void LayeredLoader::addIni(const std::string& filename)
+{
+	IniLayer layer;
+	layer.filename = SystemUtils::replaceTilta(filename);
+	m_iniFiles.push_back(std::move(layer));
+}
+
+void LayeredLoader::setMaxThreads(unsigned threads)
+{
+	m_maxThreads = threads;
+}
+
+void LayeredLoader::addEnvironment(const std::string& prefix)
+{
+	m_useEnvironment = true;
+	m_environmentPrefix = prefix;
+}
+
+void LayeredLoader::addStoredCmdline()
+{
+	m_useCmdline = true;
+}
+
+void LayeredLoader::apply()
+{
+	load();
+	TraceSpan span("merge layers");
+	span.arg("layers", m_iniFiles.size());
+
+	m_assignments.clear();
+	size_t layer = 0;
+	for (auto& it : m_iniFiles)
+	{
+		if (it.ini)
+			collectIni(*it.ini, layer++);
+		else
+			collectImage(it.image, layer++);
+	}
+	if (m_useEnvironment)
+		collectEnvironment(layer++);
+	if (m_useCmdline)
+		collectCmdline(layer);
+
+	std::sort(m_assignments.begin(), m_assignments.end(),
+		[](const Assignment& a, const Assignment& b) {
+			if (a.parameter != b.parameter)
+				return a.parameter < b.parameter;
+			return a.layer < b.layer;
+		}
+	);
+
+	for (size_t i = 0; i < m_assignments.size(); i++)
+	{
+		// Only the last one of assignments to the same parameter is used,
+		// overridden text values are only checked as sequential parsing would do
+		const Assignment& a = m_assignments[i];
+		if (i + 1 < m_assignments.size() && m_assignments[i + 1].parameter == a.parameter)
+		{
+			if (a.entry != nullptr)
+				Parameters::checkIniValue(*a.parameter, *a.entry, *a.document);
+			else if (a.environment != nullptr && !a.parameter->checkIniValue(a.environment->value))
+				throw std::runtime_error("Wrong value of environment variable " + a.environment->variable + ": '" + a.environment->value + "'");
+			continue;
+		}
+
+		if (a.entry != nullptr)
+		{
+			Parameters::applyIniValue(*a.parameter, *a.entry, *a.document);
+		} else if (a.environment != nullptr) {
+			if (!a.parameter->getFromIni(a.environment->value))
+				throw std::runtime_error("Wrong value of environment variable " + a.environment->variable + ": '" + a.environment->value + "'");
+		} else if (a.binary != nullptr) {
+			if (!a.parameter->readBinary(a.binary->data))
+				throw std::runtime_error("Damaged configuration image, value of " + std::string(a.parameter->name()));
+		} else {
+			Parameters::applyStoredOption(*a.parameter, *a.option);
+		}
+	}
+
+	span.arg("assignments", m_assignments.size());
+	if (m_parameters.m_binaryCache)
+		saveImages();
+
+	if (!m_iniFiles.empty())
+	{
+		m_parameters.m_ptSource = m_iniFiles.back().filename;
+		m_parameters.m_ptValid = false;
+	}
+	m_parameters.commitChanges();
+}
+
+void LayeredLoader::load()
+{
+	TraceSpan span("load layers");
+	span.arg("files", m_iniFiles.size());
+	// Taken before threads start, workers only read it
+	const BinaryCache::Schema* schema = m_parameters.m_binaryCache ? &m_parameters.binarySchema() : nullptr;
+
+	unsigned threads = m_maxThreads != 0 ? m_maxThreads : std::max(1u, std::thread::hardware_concurrency());
+	threads = std::min<size_t>(threads, m_iniFiles.size());
+
+	std::vector<std::exception_ptr> errors(m_iniFiles.size());
+	std::atomic<size_t> next{0};
+	auto worker = [this, schema, &errors, &next] {
+		for (size_t i = next++; i < m_iniFiles.size(); i = next++)
+		{
+			try {
+				loadLayer(m_iniFiles[i], schema);
+			} catch (...) {
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads; i++)
+		pool.emplace_back(worker);
+	worker();
+	for (auto& t : pool)
+		t.join();
+
+	for (auto& error : errors)
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+}
+
+void LayeredLoader::loadLayer(IniLayer& layer, const BinaryCache::Schema* schema) const
+{
+	if (layer.loaded)
+		return;
+	const BinaryCache* cache = m_parameters.m_binaryCache.get();
+	if (cache == nullptr || !cache->load(*schema, layer.filename, layer.image))
+		layer.ini.reset(new IniDocument(layer.filename));
+	layer.loaded = true;
+}
+
+void LayeredLoader::collectIni(const IniDocument& ini, size_t layer)
+{
+	size_t currentSection = 0;
+	ParametersGroup* group = nullptr;
+	for (const IniEntry& entry : ini.entries())
+	{
+		if (entry.sectionIndex != currentSection)
+		{
+			currentSection = entry.sectionIndex;
+			auto it = m_parameters.m_groups.find(entry.section);
+			group = it == nullptr ? nullptr : *it;
+		}
+		if (group == nullptr)
+			continue;
+
+		IAnyTypeParameter* parameter = group->findParameter(entry.key);
+		if (parameter != nullptr)
+			m_assignments.push_back(Assignment{parameter, layer, &entry, &ini, nullptr});
+	}
+}
+
+void LayeredLoader::collectImage(const BinaryImage& image, size_t layer)
+{
+	for (const BinaryImage::Value& value : image.values())
+		m_assignments.push_back(Assignment{value.parameter, layer, nullptr, nullptr, &value});
+}
+
+void LayeredLoader::collectEnvironment(size_t layer)
+{
+	TraceSpan span("scan environment");
+	// Variables are matched against index of all parameters, so the cost does
+	// not depend on size of schema beyond building the index once
+	const auto& names = m_parameters.environmentNames();
+	const std::string prefix = m_environmentPrefix + "_";
+	m_environment.clear();
+	for (char** it = environ; *it != nullptr; ++it)
+	{
+		std::string_view entry(*it);
+		size_t equals = entry.find('=');
+		if (equals == std::string_view::npos || entry.compare(0, prefix.size(), prefix) != 0)
+			continue;
+		std::string_view variable = entry.substr(0, equals);
+		auto found = names.find(std::string(variable.substr(prefix.size())));
+		if (found == names.end())
+			continue;
+		if (found->second.parameter == nullptr)
+			throw std::runtime_error("Environment variable " + std::string(variable) + " matches several parameters");
+		m_environment.push_back(EnvironmentValue{std::string(variable), std::string(entry.substr(equals + 1)), found->second.parameter});
+	}
+	span.arg("values", m_environment.size());
+
+	for (const EnvironmentValue& value : m_environment)
+		m_assignments.push_back(Assignment{value.parameter, layer, nullptr, nullptr, nullptr, &value});
+}
+
+void LayeredLoader::collectCmdline(size_t layer)
+{
+	// Short name is applied to every group that has such parameter,
+	// full name overrides it for its own group
+	std::vector<const Parameters::CmdlineName*> names;
+	m_parameters.cmdlineNames();
+	for (const Parameters::StoredOption& option : m_parameters.m_storedOptions)
+	{
+		names.clear();
+		m_parameters.findCmdlineNames(option.name, false, names);
+		for (const Parameters::CmdlineName* name : names)
+			m_assignments.push_back(Assignment{name->parameter, layer + (name->full ? 1 : 0), nullptr, nullptr, nullptr, nullptr, &option});
+	}
+}
+
+void LayeredLoader::saveImages()
+{
+	// Overridden values were not converted while applying, so they are converted here.
+	// This happens only when image is missing or outdated
+	const BinaryCache::Schema& schema = m_parameters.binarySchema();
+	for (size_t layer = 0; layer < m_iniFiles.size(); layer++)
+	{
+		const IniLayer& ini = m_iniFiles[layer];
+		if (!ini.ini)
+			continue;
+
+		// Layer with a value that has no binary form is parsed from text every time
+		std::vector<std::pair<IAnyTypeParameter*, std::string>> values;
+		bool cacheable = true;
+		for (const Assignment& a : m_assignments)
+		{
+			if (a.layer != layer || a.entry == nullptr || a.parameter->type() == ParamterType::cmdLine)
+				continue;
+			values.emplace_back(a.parameter, std::string());
+			cacheable = a.parameter->convertIniToBinary(a.entry->value, values.back().second);
+			if (!cacheable)
+				break;
+		}
+		if (cacheable)
+			m_parameters.m_binaryCache->save(schema, ini.filename, ini.ini->stamp(), values);
+	}
+}
@@ -0,0 +1,112 @@
+/*
+ * layered-loader.hpp
+ *
+ * Loading configuration from several sources in one pass
+ */
+
+#ifndef CIC_LAYERED_LOADER_HPP_
+#define CIC_LAYERED_LOADER_HPP_
+
+#include "cic.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cic {
+
+/**
+ * Merges configuration sources by precedence before any value is converted.
+ * Sources are applied in order of addition, so every parameter gets its
+ * value from the last source that contains it; environment variables
+ * override all files and values from command line always have the highest
+ * precedence. Every file is tokenized once and every
+ * parameter is assigned at most once, overridden values are converted only
+ * to check them. Files are read and tokenized concurrently, the merge does
+ * not depend on which file is ready first.
+ *
+ * The result is the same as sequential parseIni() calls followed by
+ * parseCmdline(), invalid values are rejected even if overridden, but syntax
+ * errors in any file are reported before any parameter is changed.
+ */
+class LayeredLoader
+{
+public:
+	explicit LayeredLoader(Parameters& parameters);
+
+	/**
+	 * File is read by apply(). If Parameters have binary cache, valid
+	 * compiled image is used instead of parsing the file
+	 */
+	void addIni(const std::string& filename);
+
+	/**
+	 * Use environment variables named PREFIX_GROUP_PARAM for parameters allowed
+	 * in ini files, see SystemUtils::appendEnvironmentName(). Environment is
+	 * scanned once by apply(), values have ini file syntax
+	 */
+	void addEnvironment(const std::string& prefix);
+
+	/// Use command line stored by Parameters::storeCmdline()
+	void addStoredCmdline();
+
+	/**
+	 * Set values of all parameters found in sources. Throws std::runtime_error
+	 * of the first (in order of addition) file that cannot be read or parsed,
+	 * in this case no parameter is changed
+	 */
+	void apply();
+
+	/// Most threads used to read files, 0 means hardware concurrency
+	void setMaxThreads(unsigned threads);
+
+private:
+	/// Ini file either parsed or loaded from compiled image
+	struct IniLayer
+	{
+		std::string filename;
+		std::unique_ptr<IniDocument> ini;
+		BinaryImage image;
+		bool loaded = false;
+	};
+
+	struct EnvironmentValue
+	{
+		std::string variable;
+		std::string value;
+		IAnyTypeParameter* parameter;
+	};
+
+	/// Value source for one parameter, exactly one of entry, binary, environment and option is set
+	struct Assignment
+	{
+		IAnyTypeParameter* parameter;
+		size_t layer;
+		const IniEntry* entry;
+		const IniDocument* document;
+		const BinaryImage::Value* binary;
+		const EnvironmentValue* environment = nullptr;
+		const Parameters::StoredOption* option = nullptr;
+	};
+
+	void load();
+	void loadLayer(IniLayer& layer, const BinaryCache::Schema* schema) const;
+	void collectIni(const IniDocument& ini, size_t layer);
+	void collectImage(const BinaryImage& image, size_t layer);
+	void collectEnvironment(size_t layer);
+	void collectCmdline(size_t layer);
+	void saveImages();
+
+	Parameters& m_parameters;
+	std::vector<IniLayer> m_iniFiles;
+	bool m_useCmdline = false;
+	bool m_useEnvironment = false;
+	std::string m_environmentPrefix;
+	std::vector<EnvironmentValue> m_environment;
+	unsigned m_maxThreads = 0;
+	std::vector<Assignment> m_assignments;
+};
+
+} // namespace cic
+
+#endif /* CIC_LAYERED_LOADER_HPP_ */
@@ -0,0 +1,76 @@
+#include "perfect-hash.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace cic;
+
+std::vector<int32_t> PerfectHash::build(const std::vector<std::pair<std::string_view, std::string_view>>& keys,
+		std::vector<uint32_t>& slots)
+{
+	const uint32_t size = keys.size();
+	slots.assign(size, 0);
+	std::vector<int32_t> displacements(size, 0);
+	if (size == 0)
+		return displacements;
+
+	std::vector<std::pair<std::string_view, std::string_view>> sorted(keys);
+	std::sort(sorted.begin(), sorted.end());
+	auto duplicate = std::adjacent_find(sorted.begin(), sorted.end());
+	if (duplicate != sorted.end())
+		throw std::runtime_error("Cannot build perfect hash, name is repeated: '" + std::string(duplicate->first) + "'");
+
+	std::vector<std::vector<uint32_t>> buckets(size);
+	for (uint32_t i = 0; i < size; i++)
+		buckets[hash(keys[i].first, keys[i].second, 0) % size].push_back(i);
+
+	// Large buckets are placed first while most slots are free
+	std::vector<uint32_t> order(size);
+	for (uint32_t i = 0; i < size; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(),
+		[&buckets](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+	std::vector<bool> used(size, false);
+	std::vector<uint32_t> placed;
+	size_t next = 0;
+	for (; next < order.size() && buckets[order[next]].size() > 1; next++)
+	{
+		const std::vector<uint32_t>& bucket = buckets[order[next]];
+		for (uint32_t seed = 1;; seed++)
+		{
+			if (seed > (1u << 24))
+				throw std::runtime_error("Cannot build perfect hash, no seed places bucket of '" + std::string(keys[bucket[0]].first) + "'");
+			placed.clear();
+			for (uint32_t key : bucket)
+			{
+				uint32_t slot = hash(keys[key].first, keys[key].second, seed) % size;
+				if (used[slot] || std::find(placed.begin(), placed.end(), slot) != placed.end())
+					break;
+				placed.push_back(slot);
+			}
+			if (placed.size() != bucket.size())
+				continue;
+			for (size_t i = 0; i < bucket.size(); i++)
+			{
+				used[placed[i]] = true;
+				slots[bucket[i]] = placed[i];
+			}
+			displacements[order[next]] = static_cast<int32_t>(seed);
+			break;
+		}
+	}
+
+	// Buckets of one key take free slots directly
+	uint32_t freeSlot = 0;
+	for (; next < order.size() && buckets[order[next]].size() == 1; next++)
+	{
+		while (used[freeSlot])
+			freeSlot++;
+		used[freeSlot] = true;
+		slots[buckets[order[next]][0]] = freeSlot;
+		displacements[order[next]] = -static_cast<int32_t>(freeSlot) - 1;
+	}
+	return displacements;
+}
@@ -0,0 +1,71 @@
+/*
+ * perfect-hash.hpp
+ *
+ * Minimal perfect hash of a fixed set of names. Tables are built once, e.g.
+ * by cic-schema-gen at build time, and lookups need no collision handling.
+ */
+
+#ifndef CIC_PERFECT_HASH_HPP_
+#define CIC_PERFECT_HASH_HPP_
+
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <cstdint>
+
+namespace cic {
+
+/**
+ * Hash and displace: key is hashed into a bucket, the bucket stores either
+ * seed of the second hash that places all its keys into distinct slots or,
+ * for buckets of one key, the slot itself encoded as negative number. Every
+ * key of the set gets its own slot in [0, size), other keys get any slot,
+ * so caller compares the key stored in the slot.
+ *
+ * Key is a pair of strings hashed as if they were joined by '\0', so ini
+ * section and key are looked up without concatenation
+ */
+class PerfectHash
+{
+public:
+	constexpr PerfectHash(const int32_t* displacements, uint32_t size) :
+		m_displacements(displacements), m_size(size)
+	{
+	}
+
+	uint32_t slot(std::string_view first, std::string_view second = std::string_view()) const
+	{
+		int32_t d = m_displacements[hash(first, second, 0) % m_size];
+		return d < 0 ? static_cast<uint32_t>(-d - 1) : hash(first, second, d) % m_size;
+	}
+
+	/// Count of slots, equal to count of keys. Tables of empty set have no slots
+	uint32_t size() const { return m_size; }
+
+	/// FNV-1a with offset basis changed by seed
+	static uint32_t hash(std::string_view first, std::string_view second, uint32_t seed)
+	{
+		uint32_t h = 2166136261u ^ (seed * 2654435769u);
+		for (char c : first)
+			h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+		h *= 16777619u;
+		for (char c : second)
+			h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+		return h;
+	}
+
+	/**
+	 * Displacements table for distinct keys, slots receives slot of every key.
+	 * Throws std::runtime_error if keys are not distinct
+	 */
+	static std::vector<int32_t> build(const std::vector<std::pair<std::string_view, std::string_view>>& keys,
+			std::vector<uint32_t>& slots);
+
+private:
+	const int32_t* m_displacements;
+	uint32_t m_size;
+};
+
+} // namespace cic
+
+#endif /* CIC_PERFECT_HASH_HPP_ */
@@ -0,0 +1,316 @@
+#include "reloadable.hpp"
+
+#include <boost/filesystem.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#ifdef __linux__
+	#include <sys/inotify.h>
+#endif
+
+using namespace cic;
+
+namespace {
+
+/// Returns record to the domain when thread exits
+struct ThreadRecordHolder
+{
+	~ThreadRecordHolder()
+	{
+		if (record != nullptr)
+			record->used.store(false, std::memory_order_release);
+	}
+	EpochDomain::ReaderRecord* record = nullptr;
+};
+
+} // namespace
+
+EpochDomain& EpochDomain::instance()
+{
+	static EpochDomain domain;
+	return domain;
+}
+
+EpochDomain::ReaderRecord& EpochDomain::threadRecord()
+{
+	thread_local ThreadRecordHolder holder;
+	if (holder.record == nullptr)
+		holder.record = acquireRecord();
+	return *holder.record;
+}
+
+uint64_t EpochDomain::minActiveEpoch() const
+{
+	uint64_t result = idle;
+	for (ReaderRecord* r = m_records.load(std::memory_order_acquire); r != nullptr; r = r->next)
+	{
+		uint64_t e = r->epoch.load();
+		if (e < result)
+			result = e;
+	}
+	return result;
+}
+
+EpochDomain::ReaderRecord* EpochDomain::acquireRecord()
+{
+	// Records are never deleted, so released ones are reused by new threads
+	for (ReaderRecord* r = m_records.load(std::memory_order_acquire); r != nullptr; r = r->next)
+	{
+		bool expected = false;
+		if (!r->used.load(std::memory_order_relaxed) && r->used.compare_exchange_strong(expected, true))
+			return r;
+	}
+
+	ReaderRecord* r = new ReaderRecord;
+	r->used.store(true, std::memory_order_relaxed);
+	ReaderRecord* head = m_records.load(std::memory_order_relaxed);
+	do {
+		r->next = head;
+	} while (!m_records.compare_exchange_weak(head, r, std::memory_order_release, std::memory_order_relaxed));
+	return r;
+}
+
+ReloadableParameters::Snapshot::Snapshot(EpochDomain::ReaderRecord* record, const Parameters* parameters) :
+		m_record(record),
+		m_parameters(parameters)
+{
+}
+
+ReloadableParameters::Snapshot::Snapshot(Snapshot&& other) noexcept :
+		m_record(other.m_record),
+		m_parameters(other.m_parameters)
+{
+	other.m_record = nullptr;
+	other.m_parameters = nullptr;
+}
+
+ReloadableParameters::Snapshot::~Snapshot()
+{
+	if (m_record != nullptr)
+		EpochDomain::instance().leave(*m_record);
+}
+
+ReloadableParameters::ReloadableParameters(Factory factory, const std::vector<std::string>& configFiles, const std::string& suffix) :
+		m_factory(std::move(factory)),
+		m_configFiles(configFiles),
+		m_suffix(suffix)
+{
+	reload();
+}
+
+ReloadableParameters::~ReloadableParameters()
+{
+	stopWatching();
+	// There should be no readers at this point
+	delete m_current.load();
+	for (auto& it : m_retired)
+		delete it.second;
+}
+
+void ReloadableParameters::setCmdline(int argc, const char * const * argv, bool useFull, bool useShort)
+{
+	std::lock_guard<std::mutex> lock(m_writerMutex);
+	m_cmdline.assign(argv, argv + argc);
+	m_useFull = useFull;
+	m_useShort = useShort;
+}
+
+void ReloadableParameters::reload()
+{
+	std::lock_guard<std::mutex> lock(m_writerMutex);
+	try {
+		std::unique_ptr<Parameters> next = m_factory();
+		CIC_ASSERT(next != nullptr, "Parameters factory returned nothing");
+
+		std::string filename = SystemUtils::probeFiles(m_configFiles, m_suffix);
+		if (filename != "")
+			next->parseIni(filename.c_str());
+
+		if (!m_cmdline.empty())
+		{
+			std::vector<const char*> argv;
+			for (auto& it : m_cmdline)
+				argv.push_back(it.c_str());
+			next->parseCmdline(argv.size(), argv.data(), m_useFull, m_useShort);
+		}
+		publish(std::move(next));
+		m_lastError.clear();
+	}
+	catch (std::exception& ex)
+	{
+		m_lastError = ex.what();
+		throw;
+	}
+}
+
+ReloadableParameters::Snapshot ReloadableParameters::snapshot() const
+{
+	EpochDomain& domain = EpochDomain::instance();
+	EpochDomain::ReaderRecord& record = domain.threadRecord();
+	domain.enter(record);
+	return Snapshot(&record, m_current.load());
+}
+
+void ReloadableParameters::startWatching()
+{
+#ifdef __linux__
+	if (m_watcher.joinable())
+		return;
+
+	int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	CIC_ASSERT(fd >= 0, "Cannot initialize inotify");
+
+	// Directories are watched because editors often replace files by rename
+	std::set<std::string> directories;
+	std::set<std::string> names;
+	for (auto& it : m_configFiles)
+	{
+		boost::filesystem::path file(SystemUtils::replaceTilta(it + m_suffix));
+		std::string dir = file.parent_path().string();
+		directories.insert(dir.empty() ? "." : dir);
+		names.insert(file.filename().string());
+	}
+	for (auto& dir : directories)
+	{
+		if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0)
+		{
+			std::string error = std::strerror(errno);
+			close(fd);
+			throw std::runtime_error("Cannot watch directory " + dir + ": " + error);
+		}
+	}
+
+	if (pipe2(m_stopPipe, O_CLOEXEC) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("Cannot create pipe for configuration watcher");
+	}
+	m_watcher = std::thread([this, fd, names] { watch(fd, names); });
+#else
+	throw std::runtime_error("Configuration files watching is not supported on this platform");
+#endif
+}
+
+void ReloadableParameters::stopWatching()
+{
+	if (!m_watcher.joinable())
+		return;
+	char c = 0;
+	ssize_t written = write(m_stopPipe[1], &c, 1);
+	(void) written;
+	m_watcher.join();
+	close(m_stopPipe[0]);
+	close(m_stopPipe[1]);
+	m_stopPipe[0] = m_stopPipe[1] = -1;
+}
+
+std::string ReloadableParameters::lastError() const
+{
+	std::lock_guard<std::mutex> lock(m_writerMutex);
+	return m_lastError;
+}
+
+size_t ReloadableParameters::retiredCount() const
+{
+	std::lock_guard<std::mutex> lock(m_writerMutex);
+	return m_retired.size();
+}
+
+void ReloadableParameters::publish(std::unique_ptr<Parameters> next)
+{
+	const Parameters* old = m_current.exchange(next.release());
+	if (old != nullptr)
+		m_retired.emplace_back(EpochDomain::instance().advance(), old);
+	m_version.fetch_add(1, std::memory_order_release);
+	reclaim();
+}
+
+void ReloadableParameters::reclaim()
+{
+	if (m_retired.empty())
+		return;
+
+	uint64_t minEpoch = EpochDomain::instance().minActiveEpoch();
+	auto kept = m_retired.begin();
+	for (auto it = m_retired.begin(); it != m_retired.end(); ++it)
+	{
+		if (it->first < minEpoch)
+			delete it->second;
+		else
+			*kept++ = *it;
+	}
+	m_retired.erase(kept, m_retired.end());
+}
+
+void ReloadableParameters::watch(int inotifyFd, const std::set<std::string>& names)
+{
+#ifdef __linux__
+	alignas(inotify_event) char buffer[4096];
+	for (;;)
+	{
+		// While retired configurations wait for readers, wake up to delete them
+		int timeout = -1;
+		{
+			std::lock_guard<std::mutex> lock(m_writerMutex);
+			reclaim();
+			if (!m_retired.empty())
+				timeout = reclaimIntervalMs;
+		}
+
+		pollfd fds[2] = { {m_stopPipe[0], POLLIN, 0}, {inotifyFd, POLLIN, 0} };
+		if (poll(fds, 2, timeout) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			stopOnError("poll");
+			break;
+		}
+		if (fds[0].revents != 0)
+			break;
+
+		bool changed = false;
+		ssize_t len;
+		for (;;)
+		{
+			len = read(inotifyFd, buffer, sizeof(buffer));
+			if (len < 0 && errno == EINTR)
+				continue;
+			if (len <= 0)
+				break;
+			for (char* p = buffer; p < buffer + len; )
+			{
+				inotify_event* event = reinterpret_cast<inotify_event*>(p);
+				if (event->len != 0 && names.count(event->name) != 0)
+					changed = true;
+				p += sizeof(inotify_event) + event->len;
+			}
+		}
+		if (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+		{
+			stopOnError("read");
+			break;
+		}
+
+		if (changed)
+		{
+			try {
+				reload();
+			} catch (std::exception&) {
+				// Error is stored by reload() and previous configuration is still used
+			}
+		}
+	}
+#endif
+	close(inotifyFd);
+}
+
+void ReloadableParameters::stopOnError(const char* operation)
+{
+	std::string error = std::strerror(errno);
+	std::lock_guard<std::mutex> lock(m_writerMutex);
+	m_lastError = std::string("Configuration watcher stopped, ") + operation + " failed: " + error;
+}
@@ -0,0 +1,176 @@
+/*
+ * reloadable.hpp
+ *
+ * Hot-reloadable configuration. Every reload builds a new Parameters object
+ * that is never modified after it is published. Readers get the current one
+ * without taking locks, retired objects are reclaimed using epochs.
+ */
+
+#ifndef CIC_RELOADABLE_HPP_
+#define CIC_RELOADABLE_HPP_
+
+#include "cic.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+namespace cic {
+
+/**
+ * Epoch-based reclamation domain. Every reader thread owns a record where it
+ * announces global epoch while it holds a pointer to shared object. Object
+ * retired at epoch E may be deleted when no reader announces epoch <= E.
+ */
+class EpochDomain
+{
+public:
+	static constexpr uint64_t idle = UINT64_MAX;
+
+	struct alignas(64) ReaderRecord
+	{
+		std::atomic<uint64_t> epoch{idle};
+		std::atomic<bool> used{false};
+		unsigned nesting = 0;
+		ReaderRecord* next = nullptr;
+	};
+
+	static EpochDomain& instance();
+
+	/// Record of calling thread. It is allocated on first use and released when thread exits
+	ReaderRecord& threadRecord();
+
+	void enter(ReaderRecord& record)
+	{
+		if (record.nesting++ == 0)
+			record.epoch.store(m_epoch.load(std::memory_order_acquire));
+	}
+
+	void leave(ReaderRecord& record)
+	{
+		if (--record.nesting == 0)
+			record.epoch.store(idle, std::memory_order_release);
+	}
+
+	/// Should be called after shared pointer swap, returns epoch of retired object
+	uint64_t advance() { return m_epoch.fetch_add(1); }
+
+	/// Minimal epoch announced by readers or idle if there are no active readers
+	uint64_t minActiveEpoch() const;
+
+private:
+	EpochDomain() = default;
+	ReaderRecord* acquireRecord();
+
+	std::atomic<uint64_t> m_epoch{1};
+	std::atomic<ReaderRecord*> m_records{nullptr};
+};
+
+/**
+ * Configuration that may be re-read while other threads use it.
+ *
+ * Schema is created by user-provided factory for every reload, then ini file
+ * found by SystemUtils::probeFiles and stored command line are applied and
+ * result is published with single atomic pointer swap. Failed reload leaves
+ * previous configuration in place.
+ */
+class ReloadableParameters
+{
+public:
+	using Factory = std::function<std::unique_ptr<Parameters>()>;
+
+	/**
+	 * Read-side guard. Referenced Parameters object is guaranteed to be alive
+	 * while the guard exists, so guards should not be kept for long time.
+	 */
+	class Snapshot
+	{
+	public:
+		Snapshot(Snapshot&& other) noexcept;
+		Snapshot(const Snapshot&) = delete;
+		Snapshot& operator=(const Snapshot&) = delete;
+		~Snapshot();
+
+		const Parameters& operator*() const { return *m_parameters; }
+		const Parameters* operator->() const { return m_parameters; }
+
+	private:
+		friend class ReloadableParameters;
+		Snapshot(EpochDomain::ReaderRecord* record, const Parameters* parameters);
+
+		EpochDomain::ReaderRecord* m_record;
+		const Parameters* m_parameters;
+	};
+
+	/// Builds and publishes the first configuration, throws on error
+	ReloadableParameters(Factory factory, const std::vector<std::string>& configFiles, const std::string& suffix = "");
+	~ReloadableParameters();
+
+	ReloadableParameters(const ReloadableParameters&) = delete;
+	ReloadableParameters& operator=(const ReloadableParameters&) = delete;
+
+	/// Command line is applied over ini file starting from next reload
+	void setCmdline(int argc, const char * const * argv, bool useFull = true, bool useShort = true);
+
+	/// Re-read configuration in calling thread. Throws on error, current configuration stays
+	void reload();
+
+	/// Lock-free access to current configuration
+	Snapshot snapshot() const;
+
+	/**
+	 * Start thread that reloads configuration when any of configuration files
+	 * changes. The thread also deletes retired configurations once readers
+	 * leave them. Throws std::runtime_error if directory of some file cannot
+	 * be watched. If waiting for changes fails, the thread stops and the
+	 * error is reported by lastError()
+	 */
+	void startWatching();
+	void stopWatching();
+
+	/// Number of published configurations
+	uint64_t version() const { return m_version.load(std::memory_order_acquire); }
+
+	/// Message of last failed reload or empty string
+	std::string lastError() const;
+
+	/// Configurations replaced but not deleted yet because readers may use them
+	size_t retiredCount() const;
+
+private:
+	void publish(std::unique_ptr<Parameters> next);
+	void reclaim();
+	void watch(int inotifyFd, const std::set<std::string>& names);
+	/// Store error of the watcher thread, errno is the cause
+	void stopOnError(const char* operation);
+
+	static constexpr int reclaimIntervalMs = 100;
+
+	Factory m_factory;
+	std::vector<std::string> m_configFiles;
+	std::string m_suffix;
+	std::vector<std::string> m_cmdline;
+	bool m_useFull = true;
+	bool m_useShort = true;
+
+	std::atomic<const Parameters*> m_current{nullptr};
+	std::atomic<uint64_t> m_version{0};
+
+	/// Serializes writers, protects everything below
+	mutable std::mutex m_writerMutex;
+	std::vector<std::pair<uint64_t, const Parameters*>> m_retired;
+	std::string m_lastError;
+
+	std::thread m_watcher;
+	int m_stopPipe[2] = {-1, -1};
+};
+
+} // namespace cic
+
+#endif /* CIC_RELOADABLE_HPP_ */
@@ -0,0 +1,131 @@
+/*
+ * seqlock.hpp
+ *
+ * Sequence lock that lets threads read parameters of a group while another
+ * thread parses configuration into the same Parameters object.
+ */
+
+#ifndef CIC_SEQLOCK_HPP_
+#define CIC_SEQLOCK_HPP_
+
+#include <atomic>
+#include <shared_mutex>
+#include <type_traits>
+#include <cstdint>
+
+namespace cic {
+
+/**
+ * Writers are serialized by a mutex and make the sequence odd while they
+ * change values. Readers of trivially copyable values do not block: they
+ * copy the value with atomic loads and retry if the sequence was odd or has
+ * changed. Other values cannot be copied while they are being changed, so
+ * their readers take the mutex in shared mode.
+ */
+class SequenceLock
+{
+public:
+	/// Write section of one thread, other writers wait
+	class WriteGuard
+	{
+	public:
+		explicit WriteGuard(SequenceLock* lock) :
+			m_lock(lock)
+		{
+			if (m_lock != nullptr)
+				m_lock->lockWrite();
+		}
+
+		~WriteGuard()
+		{
+			if (m_lock != nullptr)
+				m_lock->unlockWrite();
+		}
+
+		WriteGuard(const WriteGuard&) = delete;
+		WriteGuard& operator=(const WriteGuard&) = delete;
+
+	private:
+		SequenceLock* m_lock;
+	};
+
+	void lockWrite()
+	{
+		m_mutex.lock();
+		m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	void unlockWrite()
+	{
+		m_sequence.store(m_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		m_mutex.unlock();
+	}
+
+	/**
+	 * Calls f() until it runs without concurrent write section and returns its
+	 * result. f() should read shared data only with load()
+	 */
+	template <typename F>
+	auto read(F&& f) const
+	{
+		for (;;)
+		{
+			uint64_t before = m_sequence.load(std::memory_order_acquire);
+			if (before & 1)
+				continue;
+			auto result = f();
+			if (m_sequence.load(std::memory_order_relaxed) == before)
+				return result;
+		}
+	}
+
+	std::shared_mutex& mutex() const { return m_mutex; }
+
+	/// Incremented twice by every write section
+	uint64_t sequence() const { return m_sequence.load(std::memory_order_acquire); }
+
+	/**
+	 * Copy of value written by store(). Loads have acquire order, so check of
+	 * sequence that follows them is not reordered before them
+	 */
+	template <typename T>
+	static T load(const T& source)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are read without lock");
+		T result;
+		copy<T>(reinterpret_cast<const unsigned char*>(&source), reinterpret_cast<unsigned char*>(&result),
+			[](const auto* from, auto* to) { *to = __atomic_load_n(from, __ATOMIC_ACQUIRE); });
+		return result;
+	}
+
+	/// Release stores are ordered after odd sequence written by lockWrite()
+	template <typename T>
+	static void store(T& target, const T& value)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are read without lock");
+		copy<T>(reinterpret_cast<const unsigned char*>(&value), reinterpret_cast<unsigned char*>(&target),
+			[](const auto* from, auto* to) { __atomic_store_n(to, *from, __ATOMIC_RELEASE); });
+	}
+
+private:
+	/// Copies by words when alignment allows, otherwise by bytes
+	template <typename T, typename Move>
+	static void copy(const unsigned char* from, unsigned char* to, Move move)
+	{
+		if constexpr (sizeof(T) % sizeof(uint64_t) == 0 && alignof(T) >= alignof(uint64_t))
+		{
+			for (size_t i = 0; i < sizeof(T); i += sizeof(uint64_t))
+				move(reinterpret_cast<const uint64_t*>(from + i), reinterpret_cast<uint64_t*>(to + i));
+		} else {
+			for (size_t i = 0; i < sizeof(T); i++)
+				move(from + i, to + i);
+		}
+	}
+
+	std::atomic<uint64_t> m_sequence{0};
+	mutable std::shared_mutex m_mutex;
+};
+
+} // namespace cic
+
+#endif /* CIC_SEQLOCK_HPP_ */
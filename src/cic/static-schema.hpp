@@ -0,0 +1,164 @@
+/*
+ * static-schema.hpp
+ *
+ * Schema declared by types. Every parameter is a tag type, so access by tag
+ * is resolved at compile time and misspelled names do not compile.
+ */
+
+#ifndef CIC_STATIC_SCHEMA_HPP_
+#define CIC_STATIC_SCHEMA_HPP_
+
+#include "cic.hpp"
+
+#include <tuple>
+#include <type_traits>
+
+/**
+ * Declare parameter tag. Name and description are literals kept without
+ * copying. Arguments after description are passed to Parameter<Type>
+ * constructor, i.e. default value and/or ParamterType:
+ *
+ *     CIC_STATIC_PARAMETER(k, double, "k", "Value of k", 1.23);
+ */
+#define CIC_STATIC_PARAMETER(Tag, Type, Name, Description, ...) \
+	struct Tag \
+	{ \
+		using type = Type; \
+		static constexpr const char* name = Name; \
+		static constexpr const char* description = Description; \
+		static cic::Parameter<Type> make() \
+		{ \
+			return cic::Parameter<Type>(cic::StaticString::borrow(name), cic::StaticString::borrow(description), ##__VA_ARGS__); \
+		} \
+	}
+
+/**
+ * Declare group inside a struct that contains its parameters tags:
+ *
+ *     struct Input
+ *     {
+ *         CIC_STATIC_PARAMETER(k, double, "k", "Value of k", 1.23);
+ *         CIC_STATIC_PARAMETER(b, double, "b", "Value of b", 9.87);
+ *         CIC_STATIC_GROUP("Input", "Input parameters", k, b);
+ *     };
+ */
+#define CIC_STATIC_GROUP(Name, Description, ...) \
+	static constexpr const char* name = Name; \
+	static constexpr const char* description = Description; \
+	using parameters = cic::TypeList<__VA_ARGS__>
+
+namespace cic {
+
+template <typename... Types>
+struct TypeList { };
+
+namespace details {
+
+template <typename... Lists>
+struct Concat;
+
+template <>
+struct Concat<> { using type = TypeList<>; };
+
+template <typename... A>
+struct Concat<TypeList<A...>> { using type = TypeList<A...>; };
+
+template <typename... A, typename... B, typename... Rest>
+struct Concat<TypeList<A...>, TypeList<B...>, Rest...>
+{
+	using type = typename Concat<TypeList<A..., B...>, Rest...>::type;
+};
+
+template <typename T>
+struct AlwaysFalse : std::false_type { };
+
+template <typename T, typename List>
+struct IndexOf;
+
+template <typename T>
+struct IndexOf<T, TypeList<>>
+{
+	static_assert(AlwaysFalse<T>::value, "Parameter is not declared in the schema");
+	static constexpr size_t value = 0;
+};
+
+template <typename T, typename... Rest>
+struct IndexOf<T, TypeList<T, Rest...>> { static constexpr size_t value = 0; };
+
+template <typename T, typename Head, typename... Rest>
+struct IndexOf<T, TypeList<Head, Rest...>>
+{
+	static constexpr size_t value = 1 + IndexOf<T, TypeList<Rest...>>::value;
+};
+
+template <typename List>
+struct HandlesTuple;
+
+template <typename... Tags>
+struct HandlesTuple<TypeList<Tags...>> { using type = std::tuple<Handle<typename Tags::type>...>; };
+
+} // namespace details
+
+/**
+ * Compile-time schema registered in runtime Parameters object. Groups and
+ * parameters are created in Parameters on construction, so parsing, help and
+ * ini output work as usual; reading a value by tag is a tuple field access
+ * and a pointer dereference without any name lookup or dynamic_cast.
+ *
+ * Parameters should outlive the schema object. Groups are created by
+ * Parameters::createGroup(), so groups with the same names are replaced.
+ */
+template <typename... Groups>
+class StaticSchema
+{
+public:
+	using Tags = typename details::Concat<typename Groups::parameters...>::type;
+
+	explicit StaticSchema(Parameters& parameters) :
+		m_parameters(parameters)
+	{
+		(registerGroup<Groups>(typename Groups::parameters()), ...);
+	}
+
+	template <typename Tag>
+	const typename Tag::type& get() const
+	{
+		return *handle<Tag>();
+	}
+
+	template <typename Tag>
+	const Handle<typename Tag::type>& handle() const
+	{
+		return std::get<details::IndexOf<Tag, Tags>::value>(m_handles);
+	}
+
+	template <typename Tag>
+	bool initialized() const
+	{
+		return handle<Tag>().initialized();
+	}
+
+	template <typename Group>
+	ParametersGroup& group()
+	{
+		static_assert((std::is_same<Group, Groups>::value || ...), "Group is not declared in the schema");
+		return m_parameters[Group::name];
+	}
+
+	Parameters& parameters() { return m_parameters; }
+
+private:
+	template <typename Group, typename... GroupTags>
+	void registerGroup(TypeList<GroupTags...>)
+	{
+		ParametersGroup& g = m_parameters.createGroup(Group::name, Group::description);
+		((std::get<details::IndexOf<GroupTags, Tags>::value>(m_handles) = g.add(GroupTags::make())), ...);
+	}
+
+	Parameters& m_parameters;
+	typename details::HandlesTuple<Tags>::type m_handles;
+};
+
+} // namespace cic
+
+#endif /* CIC_STATIC_SCHEMA_HPP_ */
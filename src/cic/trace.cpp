@@ -0,0 +1,151 @@
+#include "trace.hpp"
+#include "cic.hpp"
+
+#include <chrono>
+#include <sstream>
+#include <cstdio>
+
+#include <unistd.h>
+
+using namespace cic;
+
+std::atomic<Tracer*> Tracer::m_active{nullptr};
+
+namespace {
+
+#ifndef CIC_NO_TRACING
+uint32_t threadNumber()
+{
+	static std::atomic<uint32_t> lastNumber{0};
+	thread_local uint32_t number = ++lastNumber;
+	return number;
+}
+#endif
+
+void appendJsonString(std::string& out, std::string_view s)
+{
+	out += '"';
+	for (char c : s)
+	{
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char code[8];
+				snprintf(code, sizeof(code), "\\u%04x", c);
+				out += code;
+			} else {
+				out += c;
+			}
+		}
+	}
+	out += '"';
+}
+
+} // namespace
+
+void Tracer::setActive(Tracer* tracer)
+{
+	m_active.store(tracer, std::memory_order_relaxed);
+}
+
+void Tracer::setAllocationsCounter(uint64_t (*counter)())
+{
+	m_allocationsCounter = counter;
+}
+
+void Tracer::record(Event&& event)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_events.push_back(std::move(event));
+}
+
+std::vector<Tracer::Event> Tracer::events() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_events;
+}
+
+void Tracer::clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_events.clear();
+}
+
+void Tracer::writeChromeTrace(std::ostream& stream) const
+{
+	std::string out = "{\"traceEvents\":[";
+	const std::string pid = std::to_string(getpid());
+	bool first = true;
+	for (const Event& e : events())
+	{
+		out += first ? "\n" : ",\n";
+		first = false;
+		out += "{\"name\":";
+		appendJsonString(out, e.name);
+		char times[96];
+		snprintf(times, sizeof(times), ",\"cat\":\"cic\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f",
+				e.startNs / 1000.0, e.durationNs / 1000.0);
+		out += times;
+		out += ",\"pid\":" + pid + ",\"tid\":" + std::to_string(e.thread) + ",\"args\":{";
+		for (size_t i = 0; i < e.args.size(); i++)
+		{
+			if (i != 0)
+				out += ',';
+			appendJsonString(out, e.args[i].first);
+			out += ':';
+			out += e.args[i].second;
+		}
+		out += "}}";
+	}
+	out += "\n],\"displayTimeUnit\":\"ms\"}\n";
+	stream.write(out.data(), out.size());
+}
+
+void Tracer::writeChromeTrace(const std::string& filename) const
+{
+	std::ostringstream stream;
+	writeChromeTrace(stream);
+	SystemUtils::writeFile(filename, stream.str(), true, true);
+}
+
+int64_t Tracer::nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifndef CIC_NO_TRACING
+
+void TraceSpan::start(const char* name)
+{
+	m_event.emplace();
+	m_event->name = name;
+	m_event->thread = threadNumber();
+	if (m_tracer->allocationsCounter() != nullptr)
+		m_allocations = m_tracer->allocationsCounter()();
+	m_event->startNs = Tracer::nowNs();
+}
+
+void TraceSpan::finish()
+{
+	m_event->durationNs = Tracer::nowNs() - m_event->startNs;
+	if (m_tracer->allocationsCounter() != nullptr)
+		m_event->args.emplace_back("allocations", std::to_string(m_tracer->allocationsCounter()() - m_allocations));
+	m_tracer->record(std::move(*m_event));
+}
+
+void TraceSpan::addString(const char* key, std::string_view value)
+{
+	std::string json;
+	appendJsonString(json, value);
+	m_event->args.emplace_back(key, std::move(json));
+}
+
+#endif // CIC_NO_TRACING
@@ -0,0 +1,132 @@
+/*
+ * trace.hpp
+ *
+ * Optional instrumentation of configuration loading. Spans are recorded only
+ * while a Tracer is active and are exported in Chrome trace_event format.
+ */
+
+#ifndef CIC_TRACE_HPP_
+#define CIC_TRACE_HPP_
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+namespace cic {
+
+/**
+ * Collector of spans. Recording is thread safe. When no tracer is active
+ * a span costs one relaxed atomic load; if library is built with
+ * CIC_NO_TRACING spans are compiled out completely.
+ */
+class Tracer
+{
+public:
+	struct Event
+	{
+		std::string name;
+		int64_t startNs;
+		int64_t durationNs;
+		uint32_t thread;
+		/// Key and value already formatted as JSON
+		std::vector<std::pair<std::string, std::string>> args;
+	};
+
+	/// Make tracer receive spans of all threads, nullptr disables tracing
+	static void setActive(Tracer* tracer);
+	static Tracer* active() { return m_active.load(std::memory_order_relaxed); }
+
+	/**
+	 * Function returning total count of allocations, for example from
+	 * replaced operator new. If set, spans get "allocations" argument
+	 */
+	void setAllocationsCounter(uint64_t (*counter)());
+	uint64_t (*allocationsCounter() const)() { return m_allocationsCounter; }
+
+	void record(Event&& event);
+	std::vector<Event> events() const;
+	void clear();
+
+	/// JSON object with traceEvents array of complete ("X") events
+	void writeChromeTrace(std::ostream& stream) const;
+	void writeChromeTrace(const std::string& filename) const;
+
+	static int64_t nowNs();
+
+private:
+	static std::atomic<Tracer*> m_active;
+
+	mutable std::mutex m_mutex;
+	std::vector<Event> m_events;
+	uint64_t (*m_allocationsCounter)() = nullptr;
+};
+
+#ifndef CIC_NO_TRACING
+
+/// Records one span from construction to destruction if tracer is active
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* name) :
+		m_tracer(Tracer::active())
+	{
+		if (m_tracer != nullptr)
+			start(name);
+	}
+
+	~TraceSpan()
+	{
+		if (m_tracer != nullptr)
+			finish();
+	}
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+	void arg(const char* key, int64_t value)
+	{
+		if (m_tracer != nullptr)
+			m_event->args.emplace_back(key, std::to_string(value));
+	}
+
+	/// Text is copied only if tracer is active, so passing const char* costs nothing otherwise
+	void arg(const char* key, std::string_view value)
+	{
+		if (m_tracer != nullptr)
+			addString(key, value);
+	}
+
+	bool enabled() const { return m_tracer != nullptr; }
+
+private:
+	void start(const char* name);
+	void finish();
+	void addString(const char* key, std::string_view value);
+
+	Tracer* m_tracer;
+	/// Created by start(), so inactive span does not construct it
+	std::optional<Tracer::Event> m_event;
+	uint64_t m_allocations = 0;
+};
+
+#else
+
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char*) { }
+	void arg(const char*, int64_t) { }
+	void arg(const char*, std::string_view) { }
+	bool enabled() const { return false; }
+};
+
+#endif // CIC_NO_TRACING
+
+} // namespace cic
+
+#endif /* CIC_TRACE_HPP_ */
@@ -8,9 +8,69 @@
 #ifndef CIC_UTILS_HPP_
 #define CIC_UTILS_HPP_
 
+#include <charconv>
+#include <cmath>
 #include <string>
+#include <string_view>
+#include <sstream>
+#include <locale>
+#include <cctype>
+#include <cstring>
+#include <type_traits>
+#include <utility>
 
+/// Numbers converted by std::to_chars and std::from_chars, characters and bool are not numbers here
 template <typename T>
+struct IsNumber : std::integral_constant<bool, std::is_arithmetic<T>::value
+		&& !std::is_same<T, bool>::value && !std::is_same<T, char>::value
+		&& !std::is_same<T, signed char>::value && !std::is_same<T, unsigned char>::value>
+{ };
+
+template <typename T, typename Enable = void>
+struct IsEqualityComparable : std::false_type { };
+
+template <typename T>
+struct IsEqualityComparable<T, std::void_t<decltype(std::declval<const T&>() == std::declval<const T&>())>> : std::true_type { };
+
+/**
+ * Specialization point for enums read and written by names:
+ *
+ *     template <>
+ *     struct EnumNames<Color>
+ *     {
+ *         static constexpr std::pair<const char*, Color> names[] = {{"red", Color::red}, {"green", Color::green}};
+ *     };
+ */
+template <typename T>
+struct EnumNames;
+
+template <typename T, typename Enable = void>
+struct HasEnumNames : std::false_type { };
+
+template <typename T>
+struct HasEnumNames<T, decltype((void) EnumNames<T>::names)> : std::true_type { };
+
+template <typename T>
+const char* enumName(T v)
+{
+	for (const auto& item : EnumNames<T>::names)
+	{
+		if (item.second == v)
+			return item.first;
+	}
+	return "";
+}
+
+inline std::string_view trimSpaces(std::string_view s)
+{
+	while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+		s.remove_prefix(1);
+	while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+		s.remove_suffix(1);
+	return s;
+}
+
+template <typename T, typename Enable = void>
 class ToStringConverter
 {
 public:
@@ -30,9 +90,224 @@ public:
 	}
 };
 
+template <typename T>
+class ToStringConverter<T, typename std::enable_if<HasEnumNames<T>::value>::type>
+{
+public:
+	static std::string to_string(T v)
+	{
+		return enumName(v);
+	}
+};
+
+/**
+ * Text of value for ini file appended to buffer. Numbers are formatted by
+ * std::to_chars, floating point values in the shortest form that reads back
+ * exactly. Other types are written by operator<<
+ */
+template <typename T, typename Enable = void>
+class IniTextWriter
+{
+public:
+	static void append(const T& v, std::string& buffer)
+	{
+		std::ostringstream oss;
+		oss.imbue(std::locale::classic());
+		oss << v;
+		buffer += oss.str();
+	}
+};
+
+template <typename T>
+class IniTextWriter<T, typename std::enable_if<IsNumber<T>::value>::type>
+{
+public:
+	static void append(const T& v, std::string& buffer)
+	{
+		char text[64];
+		auto result = std::to_chars(text, text + sizeof(text), v);
+		buffer.append(text, result.ptr);
+	}
+};
+
+template <>
+class IniTextWriter<bool>
+{
+public:
+	/// The same as operator<< gives
+	static void append(bool v, std::string& buffer)
+	{
+		buffer += v ? '1' : '0';
+	}
+};
+
+template <typename T>
+class IniTextWriter<T, typename std::enable_if<HasEnumNames<T>::value>::type>
+{
+public:
+	static void append(T v, std::string& buffer)
+	{
+		buffer += enumName(v);
+	}
+};
+
+template <>
+class IniTextWriter<std::string>
+{
+public:
+	static void append(const std::string& v, std::string& buffer)
+	{
+		buffer += v;
+	}
+};
+
+/**
+ * Conversion of text value to T. Semantics is the same as
+ * boost::property_tree stream translator has: whole text should be consumed
+ * and only surrounding whitespaces are allowed. Specialize it to support
+ * other types, generic version uses operator>>
+ */
+template <typename T, typename Enable = void>
+class FromStringConverter
+{
+public:
+	static bool from_string(std::string_view s, T& v)
+	{
+		std::istringstream iss{std::string(s)};
+		iss.imbue(std::locale::classic());
+		iss >> v;
+		if (!iss.eof())
+			iss >> std::ws;
+		return !iss.fail() && !iss.bad() && iss.get() == std::char_traits<char>::eof();
+	}
+};
+
+/**
+ * Numbers are parsed by std::from_chars without streams and locales.
+ * Infinity and NaN are accepted by from_chars, but not as configuration values
+ */
+template <typename T>
+class FromStringConverter<T, typename std::enable_if<IsNumber<T>::value>::type>
+{
+public:
+	static bool from_string(std::string_view s, T& v)
+	{
+		s = trimSpaces(s);
+		// Leading plus is accepted by streams but not by from_chars
+		if (s.size() > 1 && s.front() == '+' && s[1] != '-')
+			s.remove_prefix(1);
+		T parsed;
+		auto result = std::from_chars(s.data(), s.data() + s.size(), parsed);
+		if (result.ec != std::errc() || result.ptr != s.data() + s.size())
+			return false;
+		if constexpr (std::is_floating_point<T>::value)
+		{
+			if (!std::isfinite(parsed))
+				return false;
+		}
+		v = parsed;
+		return true;
+	}
+};
+
+template <typename T>
+class FromStringConverter<T, typename std::enable_if<HasEnumNames<T>::value>::type>
+{
+public:
+	static bool from_string(std::string_view s, T& v)
+	{
+		s = trimSpaces(s);
+		for (const auto& item : EnumNames<T>::names)
+		{
+			if (s == item.first)
+			{
+				v = item.second;
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+template <>
+class FromStringConverter<std::string>
+{
+public:
+	static bool from_string(std::string_view s, std::string& v)
+	{
+		v.assign(s.data(), s.size());
+		return true;
+	}
+};
+
+template <>
+class FromStringConverter<bool>
+{
+public:
+	/// Both "true"/"false" and "1"/"0" are accepted like boost::property_tree does
+	static bool from_string(std::string_view s, bool& v)
+	{
+		s = trimSpaces(s);
+		if (s == "true" || s == "1")
+			v = true;
+		else if (s == "false" || s == "0")
+			v = false;
+		else
+			return false;
+		return true;
+	}
+};
+
+/**
+ * Raw representation of values for compiled configuration cache. Trivially
+ * copyable types are stored byte by byte, other types are not cached unless
+ * specialization is provided
+ */
+template <typename T, typename Enable = void>
+class BinaryConverter
+{
+public:
+	static constexpr bool supported = false;
+	static void write(const T&, std::string&) { }
+	static bool read(std::string_view, T&) { return false; }
+};
+
+template <typename T>
+class BinaryConverter<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+public:
+	static constexpr bool supported = true;
+	static void write(const T& v, std::string& buffer)
+	{
+		buffer.append(reinterpret_cast<const char*>(&v), sizeof(T));
+	}
+	static bool read(std::string_view data, T& v)
+	{
+		if (data.size() != sizeof(T))
+			return false;
+		std::memcpy(&v, data.data(), sizeof(T));
+		return true;
+	}
+};
+
+template <>
+class BinaryConverter<std::string>
+{
+public:
+	static constexpr bool supported = true;
+	static void write(const std::string& v, std::string& buffer)
+	{
+		buffer.append(v);
+	}
+	static bool read(std::string_view data, std::string& v)
+	{
+		v.assign(data.data(), data.size());
+		return true;
+	}
+};
 
 template <typename T>
-class StringTool : public ToStringConverter<T>
+class StringTool : public ToStringConverter<T>, public FromStringConverter<T>
 {
 };
 
@@ -10,7 +10,13 @@ else()
 		set(GTEST_LIBRARIES ${GTEST_LIBRARY_NO_MAIN} gtest_main)
 		set(GTEST_FOUND YES)
 	else()
-		message(WARNING "Googletest repository NOT found at 3rdparty/googletest/, if you need to build unit tests run 'git submodule init && git submodule update'")
-		set(GTEST_FOUND NO)
+		find_package(GTest QUIET)
+		if(GTEST_FOUND)
+			message(STATUS "Googletest found in system")
+			set(GTEST_INCLUDE_DIR ${GTEST_INCLUDE_DIRS})
+		else()
+			message(WARNING "Googletest repository NOT found at 3rdparty/googletest/, if you need to build unit tests run 'git submodule init && git submodule update'")
+			set(GTEST_FOUND NO)
+		endif()
 	endif()
 endif()
@@ -0,0 +1,493 @@
+/*
+ * schema-gen.cpp
+ *
+ * cic-schema-gen: compiles declarative schema into C++ struct and name tables
+ * for cic::GeneratedLoader. Usage:
+ *
+ *     cic-schema-gen schema.ini output.hpp output.cpp namespace
+ *
+ * Schema is an ini file, section is a group and key is a parameter:
+ *
+ *     [Net | Network settings]
+ *     port = int | 8080 | Port to listen
+ *     key = string | | Path to key file, required | ini
+ *
+ * Value of key is type, default value, description and optional kind: ini,
+ * cmdline or both (default). Types are bool, int, unsigned, int64, uint64,
+ * float, double and string. Parameter without default value should be given,
+ * except bool that is false by default; empty string default is written as "".
+ */
+
+#include "ini-parser.hpp"
+#include "perfect-hash.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace cic;
+
+namespace {
+
+struct Field
+{
+	std::string group;
+	std::string name;
+	std::string member;
+	std::string type;
+	/// C++ initializer, empty if there is no default value
+	std::string initializer;
+	std::string description;
+	std::string kind;
+	bool flag;
+	bool required;
+};
+
+struct Group
+{
+	std::string name;
+	std::string description;
+	std::string typeName;
+	std::string member;
+	std::vector<size_t> fields;
+};
+
+std::string trim(std::string_view s)
+{
+	return std::string(trimSpaces(s));
+}
+
+std::vector<std::string> split(std::string_view s, char separator)
+{
+	std::vector<std::string> parts;
+	for (size_t begin = 0;; )
+	{
+		size_t end = s.find(separator, begin);
+		parts.push_back(trim(s.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin)));
+		if (end == std::string_view::npos)
+			return parts;
+		begin = end + 1;
+	}
+}
+
+std::string quote(std::string_view s)
+{
+	std::string result = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+			result += c;
+		} else if (static_cast<unsigned char>(c) < 0x20 || c == 0x7f) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\%03o", static_cast<unsigned char>(c));
+			result += escaped;
+		} else {
+			result += c;
+		}
+	}
+	return result + "\"";
+}
+
+bool isKeyword(const std::string& word)
+{
+	static const char* const keywords[] = {
+		"alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case",
+		"catch", "char", "char16_t", "char32_t", "class", "compl", "const", "constexpr", "const_cast",
+		"continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+		"explicit", "export", "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int",
+		"long", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or",
+		"or_eq", "private", "protected", "public", "register", "reinterpret_cast", "return", "short",
+		"signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template",
+		"this", "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union",
+		"unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq"
+	};
+	return std::find(std::begin(keywords), std::end(keywords), word) != std::end(keywords);
+}
+
+/// Name with every character that is not allowed in identifiers replaced by '_'
+std::string identifier(std::string_view name)
+{
+	std::string result;
+	for (char c : name)
+		result += isalnum(static_cast<unsigned char>(c)) ? c : '_';
+	if (result.empty() || isdigit(static_cast<unsigned char>(result[0])))
+		result.insert(0, "_");
+	if (isKeyword(result))
+		result += '_';
+	return result;
+}
+
+template <typename T>
+std::string integerInitializer(const std::string& text, const char* type)
+{
+	T value;
+	if (!StringTool<T>::from_string(text, value))
+		return std::string();
+	// The smallest value has no literal, minus is applied to positive literal
+	if (std::numeric_limits<T>::is_signed && value == std::numeric_limits<T>::min())
+		return std::string("std::numeric_limits<") + type + ">::min()";
+	return std::to_string(value) + (std::numeric_limits<T>::is_signed ? "" : "u");
+}
+
+template <typename T>
+std::string floatInitializer(const std::string& text, const char* type)
+{
+	T value;
+	if (!StringTool<T>::from_string(text, value))
+		return std::string();
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.*g", std::numeric_limits<T>::max_digits10, static_cast<double>(value));
+	std::string literal = buffer;
+	if (literal.find_first_of(".e") == std::string::npos)
+		literal += ".0";
+	return std::is_same<T, float>::value ? literal + "f" : literal;
+}
+
+std::string boolInitializer(const std::string& text)
+{
+	bool value;
+	if (!StringTool<bool>::from_string(text, value))
+		return std::string();
+	return value ? "true" : "false";
+}
+
+std::string stringInitializer(const std::string& text)
+{
+	if (text.size() >= 2 && text.front() == '"' && text.back() == '"')
+		return quote(std::string_view(text).substr(1, text.size() - 2));
+	return quote(text);
+}
+
+struct Type
+{
+	const char* name;
+	const char* cppType;
+	std::string (*initializer)(const std::string& text);
+};
+
+const Type types[] = {
+	{"bool", "bool", boolInitializer},
+	{"int", "int", [](const std::string& t) { return integerInitializer<int>(t, "int"); }},
+	{"unsigned", "unsigned", [](const std::string& t) { return integerInitializer<unsigned>(t, "unsigned"); }},
+	{"int64", "std::int64_t", [](const std::string& t) { return integerInitializer<int64_t>(t, "std::int64_t"); }},
+	{"uint64", "std::uint64_t", [](const std::string& t) { return integerInitializer<uint64_t>(t, "std::uint64_t"); }},
+	{"float", "float", [](const std::string& t) { return floatInitializer<float>(t, "float"); }},
+	{"double", "double", [](const std::string& t) { return floatInitializer<double>(t, "double"); }},
+	{"string", "std::string", stringInitializer},
+};
+
+class Schema
+{
+public:
+	explicit Schema(const std::string& filename) :
+		m_filename(filename)
+	{
+		IniDocument ini(filename);
+		size_t currentSection = static_cast<size_t>(-1);
+		for (const IniEntry& entry : ini.entries())
+		{
+			if (entry.sectionIndex == 0)
+				error(entry, "parameter '" + std::string(entry.key) + "' is not in a group");
+			if (entry.sectionIndex != currentSection)
+			{
+				currentSection = entry.sectionIndex;
+				addGroup(entry);
+			}
+			addField(entry);
+		}
+	}
+
+	void writeHeader(std::ostream& out, const std::string& headerName, const std::string& ns) const
+	{
+		std::string guard = "CIC_GENERATED_" + identifier(headerName) + "_";
+		std::transform(guard.begin(), guard.end(), guard.begin(), [](char c) { return toupper(static_cast<unsigned char>(c)); });
+
+		out << "/*\n * " << headerName << "\n *\n * Generated by cic-schema-gen from " << baseName(m_filename)
+			<< ", do not edit.\n */\n\n"
+			<< "#ifndef " << guard << "\n#define " << guard << "\n\n"
+			<< "#include \"generated-schema.hpp\"\n\n"
+			<< "#include <cstdint>\n#include <limits>\n#include <string>\n\n"
+			<< "namespace " << ns << " {\n\n"
+			<< "struct Config\n{\n";
+		for (size_t g = 0; g < m_groups.size(); g++)
+		{
+			const Group& group = m_groups[g];
+			if (g != 0)
+				out << "\n";
+			if (!group.description.empty())
+				out << "\t/// " << group.description << "\n";
+			out << "\tstruct " << group.typeName << "\n\t{\n";
+			for (size_t f : group.fields)
+			{
+				const Field& field = m_fields[f];
+				out << "\t\t/// " << field.description << "\n"
+					<< "\t\t" << field.type << " " << field.member;
+				if (!field.initializer.empty())
+					out << " = " << field.initializer;
+				else
+					out << "{}";
+				out << ";\n";
+			}
+			out << "\t} " << group.member << ";\n";
+		}
+		out << "};\n\n"
+			<< "/// Name tables for cic::GeneratedLoader<Config>\n"
+			<< "const cic::GeneratedSchema<Config>& schema();\n\n"
+			<< "} // namespace " << ns << "\n\n"
+			<< "#endif /* " << guard << " */\n";
+	}
+
+	void writeSource(std::ostream& out, const std::string& headerName, const std::string& ns) const
+	{
+		out << "/*\n * Generated by cic-schema-gen from " << baseName(m_filename) << ", do not edit.\n */\n\n"
+			<< "#include \"" << headerName << "\"\n\n"
+			<< "namespace " << ns << " {\n\n"
+			<< "namespace {\n\n"
+			<< "using Schema = cic::GeneratedSchema<Config>;\n\n";
+
+		for (size_t f = 0; f < m_fields.size(); f++)
+		{
+			const Field& field = m_fields[f];
+			out << "bool assign" << f << "(Config& config, std::string_view text) { return Schema::convert(text, config."
+				<< m_groups[m_groupOfField[f]].member << "." << field.member << "); }\n";
+		}
+
+		out << "\nconstexpr Schema::Field fields[] = {\n";
+		for (size_t f = 0; f < m_fields.size(); f++)
+		{
+			const Field& field = m_fields[f];
+			out << "\t{" << quote(field.group) << ", " << quote(field.name) << ", cic::ParamterType::" << field.kind << ", "
+				<< (field.flag ? "true" : "false") << ", " << (field.required ? "true" : "false") << ", assign" << f << "},\n";
+		}
+		out << "};\n";
+
+		// Ini keys are group and name of parameters allowed in ini files
+		std::vector<std::pair<std::string_view, std::string_view>> iniKeys;
+		std::vector<uint32_t> iniFieldOfKey;
+		for (size_t f = 0; f < m_fields.size(); f++)
+		{
+			if (m_fields[f].kind == "cmdLine")
+				continue;
+			iniKeys.emplace_back(m_fields[f].group, m_fields[f].name);
+			iniFieldOfKey.push_back(f);
+		}
+		std::vector<uint32_t> slots;
+		std::vector<int32_t> displacements = PerfectHash::build(iniKeys, slots);
+		std::vector<uint32_t> iniFields(iniKeys.size());
+		for (size_t i = 0; i < iniKeys.size(); i++)
+			iniFields[slots[i]] = iniFieldOfKey[i];
+		writeArray(out, "int32_t", "iniDisplacements", displacements);
+		writeArray(out, "uint32_t", "iniFields", iniFields);
+
+		// Name of several parameters stays in table to report it as ambiguous like boost does,
+		// e.g. short name of parameters of several groups or short name equal to full name
+		struct CmdlineName
+		{
+			std::string name;
+			size_t field;
+			bool full;
+			bool ambiguous;
+		};
+		std::vector<CmdlineName> names;
+		std::map<std::string, size_t> byName;
+		for (size_t f = 0; f < m_fields.size(); f++)
+		{
+			const Field& field = m_fields[f];
+			if (field.kind == "iniFile")
+				continue;
+			for (bool full : {false, true})
+			{
+				std::string name = full ? field.group + "." + field.name : field.name;
+				auto inserted = byName.emplace(name, names.size());
+				if (inserted.second)
+					names.push_back(CmdlineName{name, f, full, false});
+				else
+					names[inserted.first->second].ambiguous = true;
+			}
+		}
+		std::vector<std::pair<std::string_view, std::string_view>> cmdlineKeys;
+		for (const CmdlineName& name : names)
+			cmdlineKeys.emplace_back(name.name, std::string_view());
+		displacements = PerfectHash::build(cmdlineKeys, slots);
+		std::vector<const CmdlineName*> bySlot(names.size());
+		for (size_t i = 0; i < names.size(); i++)
+			bySlot[slots[i]] = &names[i];
+		writeArray(out, "int32_t", "cmdlineDisplacements", displacements);
+		if (bySlot.empty())
+		{
+			out << "\nconstexpr const Schema::CmdlineName* cmdlineNames = nullptr;\n";
+		} else {
+			out << "\nconstexpr Schema::CmdlineName cmdlineNames[] = {\n";
+			for (const CmdlineName* name : bySlot)
+			{
+				out << "\t{" << quote(name->name) << ", " << name->field << ", " << (name->full ? "true" : "false")
+					<< ", " << (name->ambiguous ? "true" : "false") << "},\n";
+			}
+			out << "};\n";
+		}
+
+		out << "\nconstexpr Schema tables{\n"
+			<< "\tfields, " << m_fields.size() << ",\n"
+			<< "\tcic::PerfectHash(iniDisplacements, " << iniKeys.size() << "), iniFields,\n"
+			<< "\tcic::PerfectHash(cmdlineDisplacements, " << names.size() << "), cmdlineNames\n"
+			<< "};\n\n"
+			<< "} // namespace\n\n"
+			<< "const cic::GeneratedSchema<Config>& schema()\n{\n\treturn tables;\n}\n\n"
+			<< "} // namespace " << ns << "\n";
+	}
+
+private:
+	void addGroup(const IniEntry& entry)
+	{
+		std::vector<std::string> parts = split(entry.section, '|');
+		Group group;
+		group.name = parts[0];
+		parts.erase(parts.begin());
+		group.description = join(parts);
+		group.member = identifier(group.name);
+		group.typeName = group.member + "Group";
+		if (group.name.empty())
+			error(entry, "group name is empty");
+		for (const Group& other : m_groups)
+		{
+			if (other.name == group.name)
+				error(entry, "group '" + group.name + "' is declared twice");
+			if (other.member == group.member)
+				error(entry, "groups '" + other.name + "' and '" + group.name + "' have the same identifier " + group.member);
+		}
+		m_groups.push_back(std::move(group));
+	}
+
+	void addField(const IniEntry& entry)
+	{
+		Group& group = m_groups.back();
+		std::vector<std::string> parts = split(entry.value, '|');
+		if (parts.size() < 3)
+			error(entry, "expected 'type | default | description', got '" + std::string(entry.value) + "'");
+
+		Field field;
+		field.group = group.name;
+		field.name = std::string(entry.key);
+		field.member = identifier(field.name);
+		field.kind = "both";
+		if (parts.size() > 3)
+		{
+			static const std::pair<const char*, const char*> kinds[] = {{"ini", "iniFile"}, {"cmdline", "cmdLine"}, {"both", "both"}};
+			for (auto& kind : kinds)
+			{
+				if (parts.back() == kind.first)
+				{
+					field.kind = kind.second;
+					parts.pop_back();
+					break;
+				}
+			}
+		}
+		field.description = join(std::vector<std::string>(parts.begin() + 2, parts.end()));
+
+		auto type = std::find_if(std::begin(types), std::end(types), [&parts](const Type& t) { return parts[0] == t.name; });
+		if (type == std::end(types))
+			error(entry, "unknown type '" + parts[0] + "'");
+		field.type = type->cppType;
+		field.flag = field.type == "bool";
+		if (!parts[1].empty())
+		{
+			field.initializer = type->initializer(parts[1]);
+			if (field.initializer.empty())
+				error(entry, "default value '" + parts[1] + "' is not " + parts[0]);
+		}
+		field.required = parts[1].empty() && !field.flag;
+
+		for (size_t f : group.fields)
+		{
+			if (m_fields[f].member == field.member)
+				error(entry, "parameters '" + m_fields[f].name + "' and '" + field.name + "' have the same identifier " + field.member);
+		}
+		group.fields.push_back(m_fields.size());
+		m_groupOfField.push_back(m_groups.size() - 1);
+		m_fields.push_back(std::move(field));
+	}
+
+	static std::string join(const std::vector<std::string>& parts)
+	{
+		std::string result;
+		for (const std::string& part : parts)
+			result += (result.empty() ? "" : " | ") + part;
+		return result;
+	}
+
+	template <typename T>
+	static void writeArray(std::ostream& out, const char* type, const char* name, const std::vector<T>& values)
+	{
+		if (values.empty())
+		{
+			out << "\nconstexpr const " << type << "* " << name << " = nullptr;\n";
+			return;
+		}
+		out << "\nconstexpr " << type << " " << name << "[] = {";
+		for (size_t i = 0; i < values.size(); i++)
+			out << (i % 16 == 0 ? "\n\t" : " ") << values[i] << ",";
+		out << "\n};\n";
+	}
+
+	static std::string baseName(const std::string& path)
+	{
+		size_t slash = path.rfind('/');
+		return slash == std::string::npos ? path : path.substr(slash + 1);
+	}
+
+	[[noreturn]] void error(const IniEntry& entry, const std::string& message) const
+	{
+		throw std::runtime_error(m_filename + ":" + std::to_string(entry.line) + ": " + message);
+	}
+
+	std::string m_filename;
+	std::vector<Group> m_groups;
+	std::vector<Field> m_fields;
+	std::vector<size_t> m_groupOfField;
+};
+
+void writeFile(const std::string& filename, const std::string& text)
+{
+	std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+	out << text;
+	if (!out)
+		throw std::runtime_error("Cannot write " + filename);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+	if (argc != 5)
+	{
+		std::cerr << "Usage: " << argv[0] << " schema.ini output.hpp output.cpp namespace" << std::endl;
+		return 2;
+	}
+	try {
+		Schema schema(argv[1]);
+		std::string header = argv[2];
+		std::string headerName = header.substr(header.rfind('/') == std::string::npos ? 0 : header.rfind('/') + 1);
+
+		std::ostringstream headerText;
+		schema.writeHeader(headerText, headerName, argv[4]);
+		std::ostringstream sourceText;
+		schema.writeSource(sourceText, headerName, argv[4]);
+		writeFile(argv[2], headerText.str());
+		writeFile(argv[3], sourceText.str());
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,95 @@
+#include "cic.hpp"
+#include "counting-allocator.hpp"
+
+#include "gtest/gtest.h"
+
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace cic;
+using namespace std;
+
+TEST(Parameters, Example1SchemaAllocations)
+{
+	// Schema of example1, every parameter is constructed once and moved to its storage
+	auto build = [] {
+		const uint64_t start = cicbench::allocationsCount();
+		Parameters p(
+			"All parameters for your program",
+			ParametersGroup(
+				"General",
+				"General program options",
+				Parameter<string>("load-ini", "Load settings from ini file", ParamterType::cmdLine),
+				Parameter<string>("save-ini", "Save setting to ini file", ParamterType::cmdLine),
+				Parameter<bool>("help", "Print help", ParamterType::cmdLine)
+			),
+			ParametersGroup(
+				"Input",
+				"Input parameters",
+				Parameter<double>("k", "Value of k", 1.23),
+				Parameter<double>("b", "Value of b", 9.87)
+			),
+			ParametersGroup(
+				"Interface",
+				"User interface parameters",
+				Parameter<std::string>("greeter", "String parameter", "Hi, user.")
+			),
+			ParametersGroup(
+				"Interface2",
+				"User interface parameters",
+				Parameter<std::string>("greeter", "String parameter", "Hi, user.")
+			)
+		);
+		const uint64_t count = cicbench::allocationsCount() - start;
+		EXPECT_EQ(p["Interface2"].get<std::string>("greeter"), "Hi, user.");
+		return count;
+	};
+
+	// The first build interns names and descriptions, the second one reuses them
+	const uint64_t first = build();
+	const uint64_t second = build();
+	EXPECT_LT(second, first);
+
+	// Parameter objects, group list nodes and indexes, with room for
+	// containers of other standard libraries
+	const uint64_t parameters = 7, groups = 4;
+	EXPECT_LE(second, 2 * parameters + 2 * groups + 1);
+}
+
+TEST(Parameters, FootprintPerParameter)
+{
+	// Names are unique to this process, so none of them is interned yet
+	const size_t count = 1000;
+	std::vector<std::string> borrowedNames, internedNames;
+	for (size_t i = 0; i < count; i++)
+	{
+		borrowedNames.push_back("borrowed-" + std::to_string(getpid()) + "-" + std::to_string(i));
+		internedNames.push_back("interned-" + std::to_string(getpid()) + "-" + std::to_string(i));
+	}
+
+	// Heap taken by arena of the group, its index and interned texts
+	auto bytesPerParameter = [count](auto makeName) {
+		const int64_t before = cicbench::allocatedBytes();
+		std::pmr::monotonic_buffer_resource arena;
+		ParametersGroup g("Footprint", "", &arena);
+		for (size_t i = 0; i < count; i++)
+			g.add(Parameter<int>(makeName(i), StaticString::borrow("Footprint parameter"), 1));
+		return (cicbench::allocatedBytes() - before) / static_cast<int64_t>(count);
+	};
+
+	const int64_t borrowed = bytesPerParameter([&borrowedNames](size_t i) {
+		return StaticString::borrow(borrowedNames[i].c_str());
+	});
+	const int64_t interned = bytesPerParameter([&internedNames](size_t i) {
+		return StaticString(internedNames[i]);
+	});
+	::testing::Test::RecordProperty("bytesPerIntParameterBorrowed", static_cast<int>(borrowed));
+	::testing::Test::RecordProperty("bytesPerIntParameterInterned", static_cast<int>(interned));
+
+	EXPECT_GE(borrowed, static_cast<int64_t>(sizeof(Parameter<int>)));
+	// Interned name adds its text and pool slot
+	EXPECT_GT(interned, borrowed);
+}
@@ -1,10 +1,28 @@
 #include "cic.hpp"
+#include "layered-loader.hpp"
+#include "reloadable.hpp"
+#include "static-schema.hpp"
+#include "perfect-hash.hpp"
+#include "test-schema.hpp"
 
 #include "gtest/gtest.h"
 
+#include <boost/property_tree/ini_parser.hpp>
+
 #include <fstream>
 #include <sstream>
 #include <cstdio>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <random>
+
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace cic;
 using namespace std;
@@ -503,3 +521,1692 @@ TEST(ParametersCollision, ConsoleGrouping)
 	//EXPECT_FALSE(p["Group3"].getInterface("bool-parameter").initialized());
 	EXPECT_FALSE(p["Group3"].getInterface("int-parameter").initialized());
 }
+
+TEST(IniParser, PropertyTreeOnDemand)
+{
+	ASSERT_TRUE(createTestIniFile()) << "Cannot create test ini file";
+	Remover r;
+
+	Parameters p(
+		"All parameters for your program",
+		ParametersGroup(
+			"Group1",
+			Parameter<int>("int-parameter", "Integer parameter")
+		)
+	);
+	ASSERT_NO_THROW(p.parseIni(testConfigFilename));
+	EXPECT_EQ(p["Group1"].get<int>("int-parameter"), 1);
+
+	const boost::property_tree::ptree& pt = p.propertyTree();
+	EXPECT_EQ(pt.get<int>("Group1.int-parameter"), 1);
+	EXPECT_EQ(pt.get<std::string>("Group2.string-parameter"), "lol");
+	EXPECT_EQ(pt.get<double>("TestingParameters.double-parameter"), -3.12e10);
+}
+
+TEST(IniParser, FormatErrors)
+{
+	Remover r;
+	Parameters p(
+		"All parameters for your program",
+		ParametersGroup(
+			"Group1",
+			Parameter<int>("int-parameter", "Integer parameter")
+		)
+	);
+
+	auto parseText = [&p](const char* text) {
+		{
+			ofstream f(testConfigFilename, ios::out);
+			f << text;
+		}
+		p.parseIni(testConfigFilename);
+	};
+
+	EXPECT_NO_THROW(parseText("; comment\n\n  [Group1]  \r\n int-parameter = 5 \r\n"));
+	EXPECT_EQ(p["Group1"].get<int>("int-parameter"), 5);
+	EXPECT_NO_THROW(parseText("[Empty]\n[Empty]\n[Group1]\nint-parameter=6"));
+	EXPECT_EQ(p["Group1"].get<int>("int-parameter"), 6);
+
+	EXPECT_ANY_THROW(parseText("[Group1\nint-parameter = 5\n"));
+	EXPECT_ANY_THROW(parseText("[Group1]\nint-parameter 5\n"));
+	EXPECT_ANY_THROW(parseText("[Group1]\n= 5\n"));
+	EXPECT_ANY_THROW(parseText("[Group1]\nint-parameter = 5\nint-parameter = 6\n"));
+	EXPECT_ANY_THROW(parseText("[Group1]\nint-parameter = 5\n[Group1]\nint-parameter = 6\n"));
+	EXPECT_ANY_THROW(parseText("[Group1]\nint-parameter = five\n"));
+	EXPECT_EQ(p["Group1"].get<int>("int-parameter"), 6) << "Value changed by wrong file";
+
+	// The first problem of file is reported at the same line as boost reports it
+	for (const char* text : {
+			"[Group1]\nk = 1\nk = 2\nbroken\n",
+			"[Group1]\nk = 1\nk = 2\n[Group2\n",
+			"k = 1\nk = 2\n= 3\n",
+			"[Group1]\nk = 1\nbroken\nk = 2\n"})
+	{
+		std::string native;
+		try {
+			parseText(text);
+		} catch (std::runtime_error& e) {
+			native = e.what();
+		}
+		try {
+			boost::property_tree::ptree pt;
+			boost::property_tree::read_ini(testConfigFilename, pt);
+			ADD_FAILURE() << "boost accepted " << text;
+		} catch (boost::property_tree::ini_parser_error& e) {
+			EXPECT_NE(native.find(":" + std::to_string(e.line()) + " - " + e.message()), string::npos) << native;
+		}
+	}
+
+	EXPECT_ANY_THROW(p.parseIni("/non/existing/file.ini"));
+}
+
+TEST(Handle, ResolvedOnce)
+{
+	ASSERT_TRUE(createTestIniFile()) << "Cannot create test ini file";
+	Remover r;
+
+	ParametersGroup g("Group1");
+	Handle<int> intHandle = g.add(Parameter<int>("int-parameter", "Integer parameter"));
+	Handle<bool> boolHandle = g.add(Parameter<bool>("bool-parameter", "Boolean parameter", true));
+	ASSERT_TRUE(intHandle.valid());
+	EXPECT_FALSE(intHandle.initialized());
+	EXPECT_EQ(boolHandle.get(), true);
+
+	Parameters p;
+	p.addGroup(std::move(g));
+	Handle<std::string> missing;
+	EXPECT_FALSE(missing.valid());
+	EXPECT_ANY_THROW(p.handle<int>("Group1", "unknown-parameter"));
+	EXPECT_ANY_THROW(p.handle<int>("UnknownGroup", "int-parameter"));
+	EXPECT_ANY_THROW(p.handle<double>("Group1", "int-parameter"));
+
+	Handle<int> fromParameters = p.handle<int>("Group1", "int-parameter");
+
+	ASSERT_NO_THROW(p.parseIni(testConfigFilename));
+	EXPECT_TRUE(intHandle.initialized());
+	EXPECT_EQ(intHandle.get(), 1);
+	EXPECT_EQ(*fromParameters, 1);
+	EXPECT_EQ(boolHandle.get(), false);
+}
+
+std::unique_ptr<Parameters> makeReloadableSchema()
+{
+	return std::make_unique<Parameters>(
+		"All parameters for your program",
+		ParametersGroup(
+			"Group1",
+			Parameter<int>("int-parameter", "Integer parameter", 0),
+			Parameter<std::string>("string-parameter", "String parameter", "default")
+		)
+	);
+}
+
+void writeGroup1(int value)
+{
+	// Replacing file by rename like editors do
+	std::string tmp = std::string(testConfigFilename) + ".tmp";
+	{
+		ofstream f(tmp, ios::out);
+		f << "[Group1]\nint-parameter = " << value << "\nstring-parameter = v" << value << "\n";
+	}
+	std::rename(tmp.c_str(), testConfigFilename);
+}
+
+TEST(Reloadable, ExplicitReload)
+{
+	Remover r;
+	writeGroup1(1);
+
+	ReloadableParameters rp(makeReloadableSchema, {testConfigFilename});
+	EXPECT_EQ(rp.version(), 1u);
+	{
+		auto s = rp.snapshot();
+		EXPECT_EQ((*s)["Group1"].get<int>("int-parameter"), 1);
+
+		writeGroup1(2);
+		ASSERT_NO_THROW(rp.reload());
+		// Old snapshot is still alive and not changed
+		EXPECT_EQ((*s)["Group1"].get<int>("int-parameter"), 1);
+	}
+	EXPECT_EQ(rp.snapshot()->group("Group1")->get<int>("int-parameter"), 2);
+
+	const char* argv[] = {"/tmp/test", "--int-parameter=5"};
+	rp.setCmdline(2, argv);
+	ASSERT_NO_THROW(rp.reload());
+	EXPECT_EQ((*rp.snapshot())["Group1"].get<int>("int-parameter"), 5);
+	EXPECT_EQ((*rp.snapshot())["Group1"].get<std::string>("string-parameter"), "v2");
+
+	{
+		ofstream f(testConfigFilename, ios::out);
+		f << "[Group1]\nint-parameter = wrong\n";
+	}
+	EXPECT_ANY_THROW(rp.reload());
+	EXPECT_FALSE(rp.lastError().empty());
+	EXPECT_EQ((*rp.snapshot())["Group1"].get<std::string>("string-parameter"), "v2");
+	EXPECT_EQ(rp.version(), 3u);
+}
+
+TEST(Reloadable, ConcurrentReaders)
+{
+	Remover r;
+	writeGroup1(0);
+
+	ReloadableParameters rp(makeReloadableSchema, {testConfigFilename});
+	std::atomic<bool> stop{false};
+	std::atomic<int> errors{0};
+
+	std::vector<std::thread> readers;
+	for (int i = 0; i < 4; i++)
+	{
+		readers.emplace_back([&rp, &stop, &errors] {
+			while (!stop.load())
+			{
+				auto s = rp.snapshot();
+				const ParametersGroup& g = (*s)["Group1"];
+				// Both values come from one file
+				if ("v" + std::to_string(g.get<int>("int-parameter")) != g.get<std::string>("string-parameter"))
+					errors++;
+			}
+		});
+	}
+
+	for (int i = 1; i <= 50; i++)
+	{
+		writeGroup1(i);
+		ASSERT_NO_THROW(rp.reload());
+	}
+	stop = true;
+	for (auto& t : readers)
+		t.join();
+
+	EXPECT_EQ(errors.load(), 0);
+	EXPECT_EQ((*rp.snapshot())["Group1"].get<int>("int-parameter"), 50);
+}
+
+TEST(Reloadable, WatchFiles)
+{
+	Remover r;
+	writeGroup1(1);
+
+	ReloadableParameters rp(makeReloadableSchema, {testConfigFilename});
+	ASSERT_NO_THROW(rp.startWatching());
+	writeGroup1(7);
+
+	for (int i = 0; i < 200 && rp.version() < 2; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	rp.stopWatching();
+	EXPECT_GE(rp.version(), 2u);
+	EXPECT_EQ((*rp.snapshot())["Group1"].get<int>("int-parameter"), 7);
+
+	// Configuration retired while read is deleted by watcher after reader leaves it
+	{
+		auto s = rp.snapshot();
+		ASSERT_NO_THROW(rp.reload());
+	}
+	EXPECT_EQ(rp.retiredCount(), 1u);
+	ASSERT_NO_THROW(rp.startWatching());
+	for (int i = 0; i < 200 && rp.retiredCount() != 0; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	EXPECT_EQ(rp.retiredCount(), 0u);
+	rp.stopWatching();
+
+	ReloadableParameters missing(makeReloadableSchema, {"/non-existing-directory/config.ini"});
+	EXPECT_THROW(missing.startWatching(), std::runtime_error);
+}
+
+TEST(ParametersGrop, ReplaceAndOrder)
+{
+	ParametersGroup g("Group");
+	g.add(
+		Parameter<int>("b", "Parameter b", 1),
+		Parameter<int>("a", "Parameter a", 2),
+		Parameter<int>("c", "Parameter c", 3)
+	);
+	const ParametersGroup& cg = g;
+	// Const lookup of not yet sorted parameters
+	EXPECT_EQ(cg.get<int>("c"), 3);
+
+	g.add(Parameter<int>("a", "Parameter a replaced", 20));
+	EXPECT_EQ(cg.get<int>("a"), 20);
+	EXPECT_EQ(g.get<int>("a"), 20);
+	EXPECT_EQ(cg.get<int>("a"), 20);
+
+	std::ostringstream oss;
+	g.writeIniItem(oss);
+	std::string ini = oss.str();
+	EXPECT_LT(ini.find("a = 20"), ini.find("b = 1"));
+	EXPECT_LT(ini.find("b = 1"), ini.find("c = 3"));
+	EXPECT_EQ(ini.find("a = 2\n"), string::npos);
+}
+
+TEST(ParametersGrop, NestedGroupNames)
+{
+	Parameters p(
+		"Nested",
+		ParametersGroup(
+			"Net",
+			Parameter<int>("timeout", "Timeout", 1),
+			Parameter<std::string>("cert", "Certificate of Net", "none")
+		),
+		ParametersGroup(
+			"Net.Tls",
+			Parameter<std::string>("cert", "Certificate", "default.pem"),
+			Parameter<int>("port", "Port", 443)
+		)
+	);
+
+	const char* argv[] = {"test", "--Net.Tls.cert=tls.pem", "--port=8443", "--Net.timeout=5"};
+	p.parseCmdline(4, argv);
+	EXPECT_EQ(p["Net.Tls"].get<std::string>("cert"), "tls.pem");
+	EXPECT_EQ(p["Net"].get<std::string>("cert"), "none");
+	EXPECT_EQ(p["Net.Tls"].get<int>("port"), 8443);
+	EXPECT_EQ(p["Net"].get<int>("timeout"), 5);
+
+	// Full name of nested group overrides short one and is not taken for parent group
+	ParametersGroup& tls = p["Net.Tls"];
+	ParametersGroup& net = p["Net"];
+	const char* argvBoth[] = {"test", "--port=1", "--Net.Tls.port=2", "--Net.cert=net.pem"};
+	p.storeCmdline(4, argvBoth);
+	tls.readPOVarsMap(p.variablesMap());
+	net.readPOVarsMap(p.variablesMap());
+	EXPECT_EQ(tls.get<int>("port"), 2);
+	EXPECT_EQ(tls.get<std::string>("cert"), "tls.pem");
+	EXPECT_EQ(net.get<std::string>("cert"), "net.pem");
+
+	boost::property_tree::ptree pt;
+	pt.put_child(boost::property_tree::ptree::path_type("Net.Tls", '/'), boost::property_tree::ptree());
+	pt.begin()->second.put("port", 993);
+	EXPECT_TRUE(tls.readPT(pt));
+	EXPECT_EQ(tls.get<int>("port"), 993);
+}
+
+TEST(ParametersGrop, FlagsFollowParameters)
+{
+	ParametersGroup g("Group");
+	g.add(
+		Parameter<int>("a", "Not initialized"),
+		Parameter<int>("b", "Parameter b", 1)
+	);
+	boost::property_tree::ptree empty;
+	EXPECT_FALSE(g.readPT(empty));
+	EXPECT_FALSE(g.initialized("a"));
+
+	// Flags of replaced parameter are dropped
+	g.add(Parameter<int>("a", "Parameter a", 2));
+	EXPECT_TRUE(g.readPT(empty));
+
+	Parameter<int> free("c", "Not initialized");
+	EXPECT_FALSE(free.initialized());
+	Parameter<int> copy = dynamic_cast<Parameter<int>&>(g.getInterface("b"));
+	EXPECT_TRUE(copy.initialized());
+	EXPECT_FALSE(copy.setByUser());
+
+	Parameters p("Flags", std::move(g));
+	const char* argv[] = {"test", "--Group.b=5"};
+	p.parseCmdline(2, argv);
+	EXPECT_TRUE(p["Group"].getInterface("b").setByUser());
+	EXPECT_FALSE(p["Group"].getInterface("a").setByUser());
+	EXPECT_FALSE(copy.setByUser());
+	ASSERT_EQ(p.lastChanges().changes().size(), 1);
+	EXPECT_EQ(p.lastChanges().changes()[0].parameter->name(), "b");
+
+	p.parseCmdline(2, argv);
+	EXPECT_TRUE(p.lastChanges().empty());
+}
+
+TEST_F(ParametersShortInit, OptionsCacheInvalidation)
+{
+	const char* argv[] = {"/tmp/test", "--int-parameter=321", "--Group3.added-parameter=5"};
+
+	const char* argvKnown[] = {"/tmp/test", "--int-parameter=321"};
+	ASSERT_NO_THROW(p.parseCmdline(2, argvKnown));
+	EXPECT_ANY_THROW(p.parseCmdline(3, argv)) << "Unknown option accepted";
+
+	p["Group3"].add(Parameter<int>("added-parameter", "Parameter added after parsing"));
+	ASSERT_NO_THROW(p.parseCmdline(3, argv));
+	EXPECT_EQ(p["Group3"].get<int>("added-parameter"), 5);
+
+	p.addGroup(ParametersGroup("Group4", Parameter<int>("other-parameter", "Parameter of new group")));
+	const char* argvNewGroup[] = {"/tmp/test", "--other-parameter=7"};
+	ASSERT_NO_THROW(p.parseCmdline(2, argvNewGroup));
+	EXPECT_EQ(p["Group4"].get<int>("other-parameter"), 7);
+
+	// Help shows current value as default, parsing does not treat defaults as set by user
+	std::ostringstream oss;
+	p.cmdlineHelp(oss, true);
+	EXPECT_NE(oss.str().find("Group4.other-parameter arg (=7)"), string::npos);
+	ASSERT_NO_THROW(p.parseCmdline(2, argvKnown));
+	EXPECT_FALSE(p.variablesMap().count("Group4.other-parameter"));
+}
+
+TEST(Parameters, HelpDefaultsFormatting)
+{
+	Parameters p("Parameters", ParametersGroup("A",
+		Parameter<double>("d", "Double value", 0.1),
+		Parameter<float>("f", "Float value", 1.1f),
+		Parameter<double>("big", "Big value", 1e300),
+		Parameter<int>("i", "Integer value", -5)
+	));
+
+	// Defaults are shown as boost::lexical_cast formats them
+	std::ostringstream oss;
+	p.cmdlineHelp(oss, true);
+	EXPECT_NE(oss.str().find("A.d arg (=0.10000000000000001)"), string::npos);
+	EXPECT_NE(oss.str().find("A.f arg (=1.10000002)"), string::npos);
+	EXPECT_NE(oss.str().find("A.big arg (=1.0000000000000001e+300)"), string::npos);
+	EXPECT_NE(oss.str().find("A.i arg (=-5)"), string::npos);
+
+	// Ini file gets the shortest form that reads back exactly
+	std::ostringstream ini;
+	p.writeIni(ini);
+	EXPECT_NE(ini.str().find("d = 0.1\n"), string::npos);
+}
+
+TEST(Parameters, ReplaceGroup)
+{
+	Parameters p("Parameters", ParametersGroup("A",
+		Parameter<int>("a", "Value of a", 0),
+		Parameter<int>("b", "Value of b", 0),
+		Parameter<int>("c", "Value of c", 0)
+	));
+	const char* argvB[] = {"test", "--b=7"};
+	ASSERT_NO_THROW(p.parseCmdline(2, argvB));
+
+	// Group of other size with the same sum of revisions
+	p.addGroup(ParametersGroup("A",
+		Parameter<int>("a", "Value of a", 0),
+		Parameter<int>("d", "Value of d", 0)
+	));
+	const char* argvD[] = {"test", "--d=7"};
+	ASSERT_NO_THROW(p.parseCmdline(2, argvD));
+	EXPECT_EQ(p["A"].get<int>("d"), 7);
+	EXPECT_THROW(p.parseCmdline(2, argvB), std::runtime_error);
+}
+
+TEST(Parameters, ReplaceGroupOwnedByCaller)
+{
+	Parameters p("Parameters");
+	auto first = std::make_unique<ParametersGroup>("A", Parameter<int>("a", "Value of a", 1));
+	p.addGroup(*first);
+	ParametersGroup second("A", Parameter<int>("a", "Value of a", 2));
+	p.addGroup(second);
+	// Index does not refer to name of the replaced group
+	first.reset();
+
+	EXPECT_EQ(p["A"].get<int>("a"), 2);
+	const char* argv[] = {"test", "--a=3"};
+	ASSERT_NO_THROW(p.parseCmdline(2, argv));
+	EXPECT_EQ(second.get<int>("a"), 3);
+
+	ParametersGroup g("G");
+	g.add(Parameter<int>("x", "First x", 1));
+	g.add(Parameter<int>("x", "Second x", 2));
+	EXPECT_EQ(g.get<int>("x"), 2);
+}
+
+TEST_F(ParametersShortInit, CmdlineMatchesFullDescription)
+{
+	namespace po = boost::program_options;
+	// Parsing with description of all options is the reference
+	auto reference = [this](const std::vector<const char*>& argv, po::variables_map& vm) -> std::string {
+		po::options_description all;
+		for (const char* g : {"Group1", "Group2", "Group3"})
+		{
+			all.add(p[g].getOptionsDesctiption(false));
+			all.add(p[g].getOptionsDesctiption(true));
+		}
+		try {
+			po::store(po::parse_command_line(argv.size(), argv.data(), all), vm);
+		} catch (po::error& e) {
+			return std::string("Command line parsing error: ") + e.what();
+		}
+		return "";
+	};
+
+	std::vector<std::vector<const char*>> cases = {
+		{"/tmp/test", "--int-par=5", "--bool-parameter"},
+		{"/tmp/test", "--string-parameter=x"},
+		{"/tmp/test", "--string-param=x"},
+		{"/tmp/test", "--Group2.double-parameter=2", "--double-parameter=3"},
+		{"/tmp/test", "--int-parameter", "7", "--Group3.string=y"},
+		{"/tmp/test", "--unknown=1"},
+		{"/tmp/test", "--int-parameter=1", "--int-parameter=2"},
+		{"/tmp/test", "--int-parameter=abc"},
+	};
+	for (auto& argv : cases)
+	{
+		po::variables_map expected;
+		std::string expectedError = reference(argv, expected);
+		std::string error;
+		try {
+			p.storeCmdline(argv.size(), argv.data());
+		} catch (std::runtime_error& e) {
+			error = e.what();
+		}
+		EXPECT_EQ(error, expectedError) << argv[1];
+		if (!error.empty())
+			continue;
+		ASSERT_EQ(p.variablesMap().size(), expected.size()) << argv[1];
+		for (auto& it : expected)
+			EXPECT_EQ(p.variablesMap().count(it.first), 1u) << it.first;
+	}
+
+	const char* argv[] = {"/tmp/test", "--Group2.double-parameter=2", "--double-parameter=3", "--int-par=5"};
+	ASSERT_NO_THROW(p.parseCmdline(4, argv));
+	EXPECT_EQ(p["Group2"].get<double>("double-parameter"), 2);
+	EXPECT_EQ(p["Group1"].get<int>("int-parameter"), 5);
+
+	const char* argvShort[] = {"/tmp/test", "--Group2.double-parameter=2"};
+	EXPECT_ANY_THROW(p.parseCmdline(2, argvShort, false, true));
+	const char* argvFull[] = {"/tmp/test", "--double-parameter=2"};
+	EXPECT_ANY_THROW(p.parseCmdline(2, argvFull, true, false));
+}
+
+TEST(Cmdline, NativeParserMatchesBoost)
+{
+	auto parse = [](Parameters::CmdlineParser parser, const std::vector<const char*>& argv, bool useFull, bool useShort) -> std::string {
+		Parameters p(
+			"Parsers comparison",
+			ParametersGroup("Net",
+				Parameter<bool>("verbose", "Flag"),
+				Parameter<int>("port", "Port", 80),
+				Parameter<double>("timeout", "Timeout", 1.5)
+			),
+			ParametersGroup("Db",
+				Parameter<int>("port", "Port", 5432),
+				Parameter<std::string>("name", "Name", "main"),
+				Parameter<int>("pool", "Only in ini file", 4, ParamterType::iniFile)
+			)
+		);
+		p.setCmdlineParser(parser);
+		std::ostringstream result;
+		try {
+			p.parseCmdline(argv.size(), argv.data(), useFull, useShort);
+		} catch (std::runtime_error& e) {
+			return e.what();
+		}
+		p.writeIni(result);
+		return result.str();
+	};
+
+	std::vector<std::vector<const char*>> cases = {
+		{"test", "--verbose", "--timeout=2.5", "--name", "other"},
+		{"test", "--Net.port=1", "--Db.port", "2", "--Db.name=x"},
+		{"test", "--port=3"},
+		{"test", "--Db.port=3", "--Net.timeout", "0.5"},
+		{"test", "--time=3"},
+		{"test", "--Db.port", "-5"},
+		{"test", "--Db.port=-5"},
+		{"test", "--Db.port=abc"},
+		{"test", "--Db.port=1", "--Db.port=2"},
+		{"test", "--verbose=true"},
+		{"test", "--name="},
+		{"test", "--pool=1"},
+		{"test", "--Db.name"},
+		{"test", "positional"},
+		{"test", "--"},
+	};
+	for (auto& argv : cases)
+	{
+		for (auto mode : {std::make_pair(true, true), std::make_pair(true, false), std::make_pair(false, true)})
+		{
+			EXPECT_EQ(parse(Parameters::CmdlineParser::native, argv, mode.first, mode.second),
+					parse(Parameters::CmdlineParser::boost, argv, mode.first, mode.second))
+				<< argv[1] << " full " << mode.first << " short " << mode.second;
+		}
+	}
+}
+
+TEST(QuickRead, LayersPrecedence)
+{
+	const char siteConfig[] = "test-config-site.ini";
+	const char localConfig[] = "test-config-local.ini";
+	const char loadedConfig[] = "test-config-loaded.ini";
+	struct FilesRemover {
+		~FilesRemover() { for (auto f : files) std::remove(f); }
+		std::vector<const char*> files;
+	} remover{{siteConfig, localConfig, loadedConfig}};
+
+	{
+		ofstream f(siteConfig, ios::out);
+		f << "[Input]\nk = 1\nb = 1\nc = 1\nd = 1\n";
+	}
+	{
+		ofstream f(localConfig, ios::out);
+		f << "[Input]\nb = 2\nc = 2\nd = 2\n";
+	}
+	{
+		ofstream f(loadedConfig, ios::out);
+		f << "[Input]\nc = 3\nd = 3\n";
+	}
+
+	Parameters p(
+		"All parameters for your program",
+		ParametersGroup(
+			"Input",
+			Parameter<int>("k", "Value of k", 0),
+			Parameter<int>("b", "Value of b", 0),
+			Parameter<int>("c", "Value of c", 0),
+			Parameter<int>("d", "Value of d", 0),
+			Parameter<int>("e", "Value of e", 0)
+		)
+	);
+	PreconfiguredOperations::addGeneralOptions(p);
+
+	const char* argv[] = {"/tmp/test", "--ini-load", loadedConfig, "--Input.d=4", "--e=5"};
+	ASSERT_TRUE(PreconfiguredOperations::quickReadConfiguration(
+			p, {siteConfig, "non-existing-config.ini", localConfig}, 5, argv));
+
+	EXPECT_EQ(p["Input"].get<int>("k"), 1);
+	EXPECT_EQ(p["Input"].get<int>("b"), 2);
+	EXPECT_EQ(p["Input"].get<int>("c"), 3);
+	EXPECT_EQ(p["Input"].get<int>("d"), 4);
+	EXPECT_EQ(p["Input"].get<int>("e"), 5);
+	EXPECT_EQ(p.propertyTree().get<int>("Input.c"), 3);
+
+	const char* argvHelp[] = {"/tmp/test", "--help"};
+	std::streambuf* coutBuffer = std::cout.rdbuf(nullptr);
+	bool needRun = PreconfiguredOperations::quickReadConfiguration(p, {siteConfig}, 2, argvHelp);
+	std::cout.rdbuf(coutBuffer);
+	EXPECT_FALSE(needRun);
+}
+
+TEST(QuickRead, EnvironmentLayer)
+{
+	const char siteConfig[] = "test-config-env.ini";
+	struct FilesRemover {
+		~FilesRemover() {
+			std::remove(file);
+			for (const char* v : {"CICTEST_INPUT_B", "CICTEST_INPUT_C", "CICTEST_INPUT_RATE_LIMIT", "CICTEST_GENERAL_INI_SAVE", "OTHER_INPUT_B"})
+				unsetenv(v);
+		}
+		const char* file;
+	} remover{siteConfig};
+	{
+		ofstream f(siteConfig, ios::out);
+		f << "[Input]\nk = 1\nb = 1\nc = 1\n";
+	}
+	setenv("CICTEST_INPUT_B", "2", 1);
+	setenv("CICTEST_INPUT_C", "2", 1);
+	setenv("CICTEST_INPUT_RATE_LIMIT", "7", 1);
+	setenv("CICTEST_GENERAL_INI_SAVE", "not-allowed-in-environment.ini", 1);
+	setenv("OTHER_INPUT_B", "10", 1);
+
+	Parameters p(
+		"All parameters for your program",
+		ParametersGroup(
+			"Input",
+			Parameter<int>("k", "Value of k", 0),
+			Parameter<int>("b", "Value of b", 0),
+			Parameter<int>("c", "Value of c", 0),
+			Parameter<int>("rate-limit", "Value with dash in name", 0)
+		)
+	);
+	PreconfiguredOperations::addGeneralOptions(p);
+
+	// Environment overrides files, command line overrides environment
+	const char* argv[] = {"/tmp/test", "--c=3"};
+	ASSERT_TRUE(PreconfiguredOperations::quickReadConfiguration(p, {siteConfig}, 2, argv, "General", "CICTEST"));
+	EXPECT_EQ(p["Input"].get<int>("k"), 1);
+	EXPECT_EQ(p["Input"].get<int>("b"), 2);
+	EXPECT_EQ(p["Input"].get<int>("c"), 3);
+	EXPECT_EQ(p["Input"].get<int>("rate-limit"), 7);
+	EXPECT_FALSE(p["General"].initialized("ini-save"));
+
+	// Without prefix environment is not read
+	setenv("CICTEST_INPUT_B", "5", 1);
+	ASSERT_TRUE(PreconfiguredOperations::quickReadConfiguration(p, {siteConfig}, 2, argv));
+	EXPECT_EQ(p["Input"].get<int>("b"), 1);
+
+	setenv("CICTEST_INPUT_B", "not-a-number", 1);
+	EXPECT_THROW(PreconfiguredOperations::quickReadConfiguration(p, {siteConfig}, 2, argv, "General", "CICTEST"), std::runtime_error);
+
+	// Names are not case sensitive, so INPUT_B is ambiguous now
+	setenv("CICTEST_INPUT_B", "2", 1);
+	p.addGroup(ParametersGroup("input", Parameter<int>("b", "Clashes with Input.b", 0)));
+	EXPECT_THROW(PreconfiguredOperations::quickReadConfiguration(p, {siteConfig}, 2, argv, "General", "CICTEST"), std::runtime_error);
+}
+
+/// Value type without binary form, images cannot hold it
+struct CachePath
+{
+	std::string value;
+};
+
+std::ostream& operator<<(std::ostream& stream, const CachePath& path)
+{
+	return stream << path.value;
+}
+
+template <>
+class ToStringConverter<CachePath>
+{
+public:
+	static std::string to_string(const CachePath& v) { return v.value; }
+};
+
+template <>
+class FromStringConverter<CachePath>
+{
+public:
+	static bool from_string(std::string_view s, CachePath& v)
+	{
+		v.value.assign(s.data(), s.size());
+		return true;
+	}
+};
+
+TEST(BinaryCache, UncacheableValue)
+{
+	char directory[] = "/tmp/cic-cache-XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+	const std::string config = std::string(directory) + "/config.ini";
+	{
+		ofstream f(config, ios::out);
+		f << "[Input]\nk = 1\npath = /etc/custom\n";
+	}
+
+	auto makeParameters = [&directory] {
+		auto p = std::make_unique<Parameters>(
+			"All parameters for your program",
+			ParametersGroup(
+				"Input",
+				Parameter<int>("k", "Value of k", 0),
+				Parameter<CachePath>("path", "Custom path", CachePath{"default"})
+			)
+		);
+		p->setBinaryCache(directory);
+		return p;
+	};
+
+	BinaryCache cache(directory);
+	BinaryImage image;
+	for (int i = 0; i < 2; i++)
+	{
+		auto p = makeParameters();
+		p->parseIni(config.c_str());
+		EXPECT_EQ((*p)["Input"].get<CachePath>("path").value, "/etc/custom") << "parse " << i;
+		EXPECT_FALSE(cache.load(p->binarySchema(), config, image));
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		auto p = makeParameters();
+		LayeredLoader loader(*p);
+		loader.addIni(config);
+		loader.apply();
+		EXPECT_EQ((*p)["Input"].get<CachePath>("path").value, "/etc/custom") << "layered load " << i;
+		EXPECT_FALSE(cache.load(p->binarySchema(), config, image));
+	}
+
+	std::remove(config.c_str());
+	rmdir(directory);
+}
+
+TEST(BinaryCache, ImageReuse)
+{
+	char directory[] = "/tmp/cic-cache-XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+	const std::string config = std::string(directory) + "/config.ini";
+	{
+		ofstream f(config, ios::out);
+		f << "[Input]\nk = 1\ns = some text\nb = true\n";
+	}
+
+	auto makeParameters = [] {
+		return std::make_unique<Parameters>(
+			"All parameters for your program",
+			ParametersGroup(
+				"Input",
+				Parameter<int>("k", "Value of k", 0),
+				Parameter<std::string>("s", "Value of s", ""),
+				Parameter<bool>("b", "Value of b", false),
+				Parameter<int>("e", "Value of e", 0)
+			)
+		);
+	};
+
+	auto p1 = makeParameters();
+	p1->setBinaryCache(directory);
+	p1->parseIni(config.c_str());
+
+	BinaryCache cache(directory);
+	BinaryImage image;
+	ASSERT_TRUE(cache.load(p1->binarySchema(), config, image));
+	EXPECT_EQ(image.values().size(), 3);
+
+	auto p2 = makeParameters();
+	p2->setBinaryCache(directory);
+	p2->parseIni(config.c_str());
+	EXPECT_EQ((*p2)["Input"].get<int>("k"), 1);
+	EXPECT_EQ((*p2)["Input"].get<std::string>("s"), "some text");
+	EXPECT_TRUE((*p2)["Input"].get<bool>("b"));
+	EXPECT_EQ((*p2)["Input"].get<int>("e"), 0);
+	EXPECT_EQ(p2->propertyTree().get<int>("Input.k"), 1);
+
+	// Changed source file invalidates image
+	{
+		ofstream f(config, ios::out);
+		f << "[Input]\nk = 22\n";
+	}
+	EXPECT_FALSE(cache.load(p2->binarySchema(), config, image));
+	p2->parseIni(config.c_str());
+	EXPECT_EQ((*p2)["Input"].get<int>("k"), 22);
+	EXPECT_TRUE(cache.load(p2->binarySchema(), config, image));
+
+	// Changed schema invalidates image
+	auto p3 = makeParameters();
+	p3->addGroup(ParametersGroup("Other", Parameter<int>("x", "Value of x", 0)));
+	EXPECT_FALSE(cache.load(p3->binarySchema(), config, image));
+
+	std::remove(cache.imagePath(config).c_str());
+	std::remove(config.c_str());
+	rmdir(directory);
+}
+
+TEST(BinaryCache, ConcurrentLoads)
+{
+	char directory[] = "/tmp/cic-cache-XXXXXX";
+	ASSERT_NE(mkdtemp(directory), nullptr);
+	const size_t count = 8;
+	std::vector<std::string> files;
+	struct FilesRemover {
+		~FilesRemover()
+		{
+			for (auto& f : *files)
+			{
+				std::remove(BinaryCache(directory).imagePath(f).c_str());
+				std::remove(f.c_str());
+			}
+			rmdir(directory);
+		}
+		std::vector<std::string>* files;
+		const char* directory;
+	} remover{&files, directory};
+	for (size_t i = 0; i < count; i++)
+	{
+		files.push_back(std::string(directory) + "/layer-" + std::to_string(i) + ".ini");
+		ofstream f(files.back(), ios::out);
+		f << "[Group" << i % 3 << "]\nlast = " << i << "\n";
+		f << "p" << i << " = " << i << "\n";
+	}
+
+	// Groups and parameters are added one by one, so indexes have unsorted tails when loading starts
+	auto makeParameters = [count, &directory] {
+		auto p = std::make_unique<Parameters>();
+		p->setBinaryCache(directory);
+		for (size_t g = 3; g-- > 0;)
+		{
+			ParametersGroup& group = p->createGroup(("Group" + std::to_string(g)).c_str());
+			for (size_t i = count; i-- > 0;)
+				group.add(Parameter<int>(("p" + std::to_string(i)).c_str(), "Layer value", -1));
+			group.add(Parameter<int>("last", "Last layer", -1));
+		}
+		return p;
+	};
+
+	// The first pass writes images, the second one loads all of them concurrently
+	for (int pass = 0; pass < 2; pass++)
+	{
+		auto p = makeParameters();
+		LayeredLoader loader(*p);
+		loader.setMaxThreads(4);
+		for (auto& f : files)
+			loader.addIni(f);
+		loader.apply();
+		for (size_t i = 0; i < count; i++)
+		{
+			std::string group = "Group" + std::to_string(i % 3);
+			size_t last = i;
+			while (last + 3 < count)
+				last += 3;
+			EXPECT_EQ((*p)[group].get<int>("p" + std::to_string(i)), i);
+			EXPECT_EQ((*p)[group].get<int>("last"), last);
+		}
+	}
+	BinaryImage image;
+	EXPECT_TRUE(BinaryCache(directory).load(makeParameters()->binarySchema(), files[0], image));
+}
+
+TEST(Parameters, ArenaGroups)
+{
+	struct CountingResource : std::pmr::memory_resource
+	{
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			allocations++;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override
+		{
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+		size_t allocations = 0;
+	} upstream;
+
+	const size_t count = 1000;
+	{
+		Parameters p;
+		p.setMemoryResource(&upstream);
+		ParametersGroup& g = p.createGroup("Input", "Input parameters");
+		Handle<int> first = g.add(Parameter<int>("p0", "Long description that does not fit into short string buffer", 0));
+		for (size_t i = 1; i < count; i++)
+		{
+			std::string name = "p" + std::to_string(i);
+			g.add(Parameter<int>(name.c_str(), "Long description that does not fit into short string buffer", i));
+		}
+		p.createGroup("Output").add(Parameter<std::string>("name", "Name", "value"));
+
+		EXPECT_EQ(p["Input"].get<int>("p999"), 999);
+		EXPECT_EQ(*first, 0);
+		EXPECT_EQ(p["Output"].get<std::string>("name"), "value");
+		EXPECT_THROW(p.setMemoryResource(std::pmr::new_delete_resource()), std::runtime_error);
+
+		// Parameter objects are carved from a few blocks
+		EXPECT_GT(upstream.allocations, 0);
+		EXPECT_LT(upstream.allocations, 20);
+	}
+}
+
+namespace {
+
+struct StaticInput
+{
+	CIC_STATIC_PARAMETER(k, double, "k", "Value of k", 1.23);
+	CIC_STATIC_PARAMETER(b, int, "b", "Value of b", 5);
+	CIC_STATIC_PARAMETER(file, std::string, "file", "Input file");
+	CIC_STATIC_GROUP("Input", "Input parameters", k, b, file);
+};
+
+struct StaticInterface
+{
+	CIC_STATIC_PARAMETER(greeter, std::string, "greeter", "String parameter", "Hi, user.");
+	CIC_STATIC_PARAMETER(verbose, bool, "verbose", "Verbose output", ParamterType::cmdLine);
+	CIC_STATIC_GROUP("Interface", "User interface parameters", greeter, verbose);
+};
+
+} // namespace
+
+TEST(Parameters, NamesStorage)
+{
+	static const char borrowedName[] = "borrowed";
+	static const char borrowedDescription[] = "Description kept by pointer";
+	std::string dynamicName = "dyn" + std::to_string(getpid());
+	std::string sameName = dynamicName;
+
+	struct CountingResource : std::pmr::memory_resource
+	{
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			allocated += bytes;
+			return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+		}
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override
+		{
+			std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+		}
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+		size_t allocated = 0;
+	} resource;
+
+	std::pmr::memory_resource* groupResource = &resource;
+	ParametersGroup g("Group", "", groupResource);
+	g.add(Parameter<int>(StaticString::borrow(borrowedName), StaticString::borrow(borrowedDescription), 1));
+	g.add(Parameter<int>(dynamicName, "Integer parameter", 2));
+
+	// Borrowed texts are not copied, equal interned texts share storage
+	EXPECT_EQ(g.findParameter("borrowed")->name().data(), borrowedName);
+	IAnyTypeParameter* interned = g.findParameter(dynamicName);
+	ASSERT_NE(interned, nullptr);
+	EXPECT_NE(interned->name().data(), dynamicName.data());
+	EXPECT_EQ(StaticString::intern(sameName).c_str(), interned->name().data());
+	EXPECT_EQ(g.get<int>(dynamicName), 2);
+
+	// Stored parameter takes only its object, texts are not copied again
+	EXPECT_EQ(resource.allocated, 2 * sizeof(Parameter<int>));
+}
+
+TEST(StaticSchema, Access)
+{
+	Parameters p("All parameters for your program");
+	StaticSchema<StaticInput, StaticInterface> schema(p);
+
+	EXPECT_EQ(schema.get<StaticInput::k>(), 1.23);
+	EXPECT_EQ(schema.get<StaticInput::b>(), 5);
+	EXPECT_EQ(schema.get<StaticInterface::greeter>(), "Hi, user.");
+	EXPECT_FALSE(schema.initialized<StaticInput::file>());
+
+	const char* argv[] = {"/tmp/test", "--Input.k=2.5", "--file=input.txt", "--verbose"};
+	p.parseCmdline(4, argv);
+	EXPECT_EQ(schema.get<StaticInput::k>(), 2.5);
+	EXPECT_EQ(schema.get<StaticInput::file>(), "input.txt");
+	EXPECT_TRUE(schema.get<StaticInterface::verbose>());
+
+	// Runtime access sees the same values
+	EXPECT_EQ(schema.group<StaticInput>().get<double>("k"), 2.5);
+	EXPECT_EQ(p["Interface"].get<std::string>("greeter"), "Hi, user.");
+
+	std::ostringstream ini;
+	p.writeIni(ini);
+	EXPECT_NE(ini.str().find("k = 2.5"), std::string::npos);
+	EXPECT_EQ(ini.str().find("verbose"), std::string::npos);
+
+	std::ostringstream help;
+	p.cmdlineHelp(help);
+	EXPECT_NE(help.str().find("Value of k"), std::string::npos);
+}
+
+TEST(PerfectHash, EveryKeyHasOwnSlot)
+{
+	std::vector<std::string> groups, names;
+	for (size_t i = 0; i < 1000; i++)
+	{
+		groups.push_back("Group" + std::to_string(i % 37));
+		names.push_back("parameter-" + std::to_string(i));
+	}
+	std::vector<std::pair<std::string_view, std::string_view>> keys;
+	for (size_t i = 0; i < groups.size(); i++)
+		keys.emplace_back(groups[i], names[i]);
+
+	std::vector<uint32_t> slots;
+	std::vector<int32_t> displacements = PerfectHash::build(keys, slots);
+	PerfectHash hash(displacements.data(), displacements.size());
+	std::vector<bool> used(keys.size(), false);
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		uint32_t slot = hash.slot(keys[i].first, keys[i].second);
+		ASSERT_EQ(slot, slots[i]);
+		EXPECT_FALSE(used[slot]) << names[i];
+		used[slot] = true;
+	}
+	EXPECT_LT(hash.slot("Group1", "unknown"), keys.size());
+
+	keys.push_back(keys[10]);
+	EXPECT_THROW(PerfectHash::build(keys, slots), std::runtime_error);
+}
+
+TEST(GeneratedSchema, IniAndCmdline)
+{
+	const char iniFile[] = "test-config-generated.ini";
+	struct FileRemover {
+		~FileRemover() { std::remove(name); }
+		const char* name;
+	} remover{iniFile};
+	{
+		ofstream f(iniFile, ios::out);
+		f << "[Net]\nport = 81\nhost = ignored\nunknown = 1\n"
+			<< "[Net.Tls]\ncert = server.pem\nmin-version = 3\n";
+	}
+
+	test_schema::Config config;
+	EXPECT_EQ(config.Net.port, 8080);
+	EXPECT_EQ(config.Net.host, "localhost");
+	EXPECT_EQ(config.Net_Tls.port, 443);
+
+	GeneratedLoader<test_schema::Config> loader(test_schema::schema(), config);
+	EXPECT_FALSE(loader.initialized());
+	loader.parseIni(iniFile);
+	EXPECT_TRUE(loader.initialized());
+	EXPECT_EQ(config.Net.port, 81);
+	EXPECT_EQ(config.Net.host, "localhost") << "Command line parameter read from ini file";
+	EXPECT_EQ(config.Net_Tls.cert, "server.pem");
+	EXPECT_EQ(config.Net_Tls.min_version, 3u);
+
+	const char* argv[] = {"test", "--timeout", "2.5", "--verbose", "--Net.Tls.port=8443", "--host=example.org"};
+	loader.parseCmdline(6, argv);
+	EXPECT_EQ(config.Net.timeout, 2.5);
+	EXPECT_TRUE(config.Net.verbose);
+	EXPECT_EQ(config.Net_Tls.port, 8443);
+	EXPECT_EQ(config.Net.host, "example.org");
+	EXPECT_EQ(config.Net.port, 81);
+
+	// Full name overrides short one whatever the order is
+	const char* argvOverride[] = {"test", "--Net.timeout=4", "--timeout=3"};
+	loader.parseCmdline(3, argvOverride);
+	EXPECT_EQ(config.Net.timeout, 4);
+
+	auto error = [&loader](std::vector<const char*> args) -> std::string {
+		try {
+			loader.parseCmdline(args.size(), args.data());
+		} catch (std::runtime_error& e) {
+			return e.what();
+		}
+		return "";
+	};
+	EXPECT_NE(error({"test", "--port=1"}).find("ambiguous"), std::string::npos);
+	// Full name equal to short name of other group is ambiguous too
+	EXPECT_NE(error({"test", "--Net.host=full.org"}).find("ambiguous"), std::string::npos);
+	EXPECT_EQ(config.Net.host, "example.org");
+	EXPECT_EQ(config.Legacy.Net_host, "old");
+	EXPECT_NE(error({"test", "--cert=x"}).find("unrecognised option '--cert=x'"), std::string::npos);
+	EXPECT_NE(error({"test", "--Net.port=abc"}).find("is invalid"), std::string::npos);
+	EXPECT_NE(error({"test", "--Net.port"}).find("is missing"), std::string::npos);
+	EXPECT_NE(error({"test", "--verbose=true"}).find("does not take any arguments"), std::string::npos);
+	EXPECT_NE(error({"test", "--host=a", "--host=b"}).find("more than once"), std::string::npos);
+	EXPECT_NE(error({"test", "--", "file"}).find("too many positional options"), std::string::npos);
+	// Nothing is assigned if any value is invalid
+	EXPECT_NE(error({"test", "--Net.timeout=7", "--Net.port=abc"}).find("is invalid"), std::string::npos);
+	EXPECT_EQ(config.Net.timeout, 4);
+	EXPECT_EQ(config.Net.port, 81);
+
+	{
+		ofstream f(iniFile, ios::out);
+		f << "[Net]\nport = 82\ntimeout = slow\n";
+	}
+	EXPECT_THROW(loader.parseIni(iniFile), std::runtime_error);
+	EXPECT_EQ(config.Net.port, 81);
+}
+
+TEST(LayeredLoader, ManyFilesInOrder)
+{
+	const size_t count = 12;
+	std::vector<std::string> files;
+	struct FilesRemover {
+		~FilesRemover() { for (auto& f : *files) std::remove(f.c_str()); }
+		std::vector<std::string>* files;
+	} remover{&files};
+	for (size_t i = 0; i < count; i++)
+	{
+		files.push_back("test-config-layer-" + std::to_string(i) + ".ini");
+		ofstream f(files.back(), ios::out);
+		f << "[Input]\nlast = " << i << "\n";
+		f << "p" << i << " = " << i << "\n";
+	}
+
+	auto makeParameters = [count] {
+		auto p = std::make_unique<Parameters>();
+		ParametersGroup& g = p->createGroup("Input");
+		g.add(Parameter<int>("last", "Last layer", -1));
+		for (size_t i = 0; i < count; i++)
+			g.add(Parameter<int>(("p" + std::to_string(i)).c_str(), "Layer value", -1));
+		return p;
+	};
+
+	for (unsigned threads : {1u, 4u, 0u})
+	{
+		auto p = makeParameters();
+		LayeredLoader loader(*p);
+		loader.setMaxThreads(threads);
+		for (auto& f : files)
+			loader.addIni(f);
+		loader.apply();
+		EXPECT_EQ((*p)["Input"].get<int>("last"), count - 1);
+		for (size_t i = 0; i < count; i++)
+			EXPECT_EQ((*p)["Input"].get<int>("p" + std::to_string(i)), i);
+	}
+
+	// Error of the first broken file is reported and nothing is changed
+	{
+		ofstream f(files[3], ios::out);
+		f << "[Input\n";
+	}
+	{
+		ofstream f(files[7], ios::out);
+		f << "last\n";
+	}
+	auto p = makeParameters();
+	LayeredLoader loader(*p);
+	for (auto& f : files)
+		loader.addIni(f);
+	try {
+		loader.apply();
+		FAIL() << "Exception expected";
+	} catch (std::runtime_error& e) {
+		EXPECT_NE(std::string(e.what()).find(files[3]), std::string::npos);
+	}
+	EXPECT_EQ((*p)["Input"].get<int>("last"), -1);
+}
+
+TEST(LayeredLoader, OverriddenValuesChecked)
+{
+	const char lowerConfig[] = "test-config-lower.ini";
+	const char upperConfig[] = "test-config-upper.ini";
+	struct FilesRemover {
+		~FilesRemover() { for (auto f : files) std::remove(f); unsetenv("CICTEST_INPUT_B"); }
+		std::vector<const char*> files;
+	} remover{{lowerConfig, upperConfig}};
+	{
+		ofstream f(lowerConfig, ios::out);
+		f << "[Input]\na = wrong\n";
+	}
+	{
+		ofstream f(upperConfig, ios::out);
+		f << "[Input]\na = 2\nb = 2\n";
+	}
+
+	Parameters p(
+		"All parameters for your program",
+		ParametersGroup(
+			"Input",
+			Parameter<int>("a", "Value of a", 0),
+			Parameter<int>("b", "Value of b", 0)
+		)
+	);
+
+	// Sequential parsing fails on the lower file, so does the loader
+	LayeredLoader loader(p);
+	loader.addIni(lowerConfig);
+	loader.addIni(upperConfig);
+	try {
+		loader.apply();
+		FAIL() << "Exception expected";
+	} catch (std::runtime_error& e) {
+		EXPECT_NE(std::string(e.what()).find(lowerConfig), std::string::npos);
+	}
+
+	setenv("CICTEST_INPUT_B", "wrong", 1);
+	const char* argv[] = {"test", "--b=3"};
+	p.storeCmdline(2, argv);
+	LayeredLoader envLoader(p);
+	envLoader.addIni(upperConfig);
+	envLoader.addEnvironment("CICTEST");
+	envLoader.addStoredCmdline();
+	EXPECT_THROW(envLoader.apply(), std::runtime_error);
+}
+
+TEST(IniWriter, RoundTripAndAtomic)
+{
+	const char filename[] = "test-config-written.ini";
+	struct FileRemover {
+		~FileRemover() { std::remove(filename); }
+		const char* filename;
+	} remover{filename};
+
+	auto makeParameters = [] {
+		return std::make_unique<Parameters>(
+			"All parameters for your program",
+			ParametersGroup(
+				"Values",
+				"Values of different types",
+				Parameter<double>("sum", "Inexact sum", 0.1 + 0.2),
+				Parameter<double>("big", "Big value", 1e300),
+				Parameter<float>("small", "Float value", 1.1f),
+				Parameter<long long>("min", "Minimal value", -9223372036854775807ll - 1),
+				Parameter<bool>("flag", "Boolean value", true),
+				Parameter<std::string>("text", "String value", "some text"),
+				Parameter<int>("cmdline", "Not written", 1, ParamterType::cmdLine)
+			)
+		);
+	};
+
+	auto written = makeParameters();
+	for (bool atomic : {false, true})
+	{
+		written->writeIni(filename, atomic);
+
+		auto read = makeParameters();
+		read->parseIni(filename);
+		EXPECT_EQ((*read)["Values"].get<double>("sum"), 0.1 + 0.2);
+		EXPECT_EQ((*read)["Values"].get<double>("big"), 1e300);
+		EXPECT_EQ((*read)["Values"].get<float>("small"), 1.1f);
+		EXPECT_EQ((*read)["Values"].get<long long>("min"), -9223372036854775807ll - 1);
+		EXPECT_TRUE((*read)["Values"].get<bool>("flag"));
+		EXPECT_EQ((*read)["Values"].get<std::string>("text"), "some text");
+	}
+
+	std::ostringstream stream;
+	written->writeIni(stream);
+	EXPECT_NE(stream.str().find("# Inexact sum\nsum = 0.30000000000000004\n"), std::string::npos);
+	EXPECT_NE(stream.str().find("flag = 1\n"), std::string::npos);
+	EXPECT_EQ(stream.str().find("cmdline"), std::string::npos);
+
+	// Atomic replacement keeps permissions of existing file
+	ASSERT_EQ(chmod(filename, 0600), 0);
+	written->writeIni(filename, true);
+	struct stat st;
+	ASSERT_EQ(stat(filename, &st), 0);
+	EXPECT_EQ(st.st_mode & 0777, 0600u);
+
+	// Concurrent atomic writers of one file do not share temporary file
+	std::vector<std::unique_ptr<Parameters>> writers;
+	for (int i = 0; i < 4; i++)
+		writers.push_back(makeParameters());
+	std::atomic<int> failures{0};
+	std::vector<std::thread> threads;
+	for (auto &w : writers)
+	{
+		threads.emplace_back([&w, &failures, &filename] {
+			for (int i = 0; i < 20; i++)
+			{
+				try {
+					w->writeIni(filename, true);
+				} catch (const std::runtime_error&) {
+					failures++;
+				}
+			}
+		});
+	}
+	for (auto &t : threads)
+		t.join();
+	EXPECT_EQ(failures, 0);
+	auto read = makeParameters();
+	read->parseIni(filename);
+	EXPECT_EQ((*read)["Values"].get<std::string>("text"), "some text");
+
+	EXPECT_THROW(written->writeIni("non-existing-directory/config.ini"), std::runtime_error);
+	EXPECT_THROW(written->writeIni("non-existing-directory/config.ini", true), std::runtime_error);
+}
+
+TEST(IniWriter, SaveKeepsSymlink)
+{
+	const char filename[] = "test-config-saved.ini";
+	const char link[] = "test-config-link.ini";
+	struct FileRemover {
+		~FileRemover() { std::remove(filename); std::remove(link); }
+		const char* filename;
+		const char* link;
+	} remover{filename, link};
+	{
+		ofstream f(filename, ios::out);
+	}
+	ASSERT_EQ(symlink(filename, link), 0);
+
+	Parameters p("Save", ParametersGroup("Input", Parameter<int>("k", "Value of k", 0)));
+	PreconfiguredOperations::addGeneralOptions(p);
+	std::string save = std::string("--ini-save=") + link;
+	const char* argv[] = {"/tmp/test", "--k=5", save.c_str()};
+
+	// Default save rewrites file the link points to
+	ASSERT_TRUE(PreconfiguredOperations::quickReadConfiguration(p, {}, 3, argv));
+	struct stat st;
+	ASSERT_EQ(lstat(link, &st), 0);
+	EXPECT_TRUE(S_ISLNK(st.st_mode));
+	Parameters read("Read", ParametersGroup("Input", Parameter<int>("k", "Value of k", 0)));
+	read.parseIni(filename);
+	EXPECT_EQ(read["Input"].get<int>("k"), 5);
+
+	// Atomic save replaces link itself
+	ASSERT_TRUE(PreconfiguredOperations::quickReadConfiguration(p, {}, 3, argv, "General", "", true));
+	ASSERT_EQ(lstat(link, &st), 0);
+	EXPECT_TRUE(S_ISREG(st.st_mode));
+}
+
+enum class Color { red, green, blue };
+
+template <>
+struct EnumNames<Color>
+{
+	static constexpr std::pair<const char*, Color> names[] = {{"red", Color::red}, {"green", Color::green}, {"blue", Color::blue}};
+};
+
+TEST(Conversion, DoubleRoundTrip)
+{
+	std::mt19937_64 random(42);
+	std::vector<double> values{0.0, -0.0, 0.1, 1.0 / 3.0, 5e-324, 2.2250738585072014e-308,
+		std::numeric_limits<double>::max(), std::numeric_limits<double>::lowest()};
+	for (int i = 0; i < 10000; i++)
+	{
+		uint64_t bits = random();
+		double v;
+		std::memcpy(&v, &bits, sizeof(v));
+		if (std::isfinite(v))
+			values.push_back(v);
+	}
+
+	for (double v : values)
+	{
+		std::string text;
+		IniTextWriter<double>::append(v, text);
+		double parsed;
+		ASSERT_TRUE(StringTool<double>::from_string(text, parsed)) << text;
+		ASSERT_EQ(std::memcmp(&v, &parsed, sizeof(v)), 0) << text;
+	}
+
+	// Through ini file and command line
+	Parameters p("Parameters", ParametersGroup("Values", Parameter<double>("x", "Value", 0.0)));
+	const char filename[] = "test-config-double.ini";
+	for (size_t i = 0; i < values.size(); i += 500)
+	{
+		{
+			std::string text;
+			IniTextWriter<double>::append(values[i], text);
+			ofstream f(filename, ios::out);
+			f << "[Values]\nx = " << text << "\n";
+
+			std::string option = "--x=" + text;
+			const char* argv[] = {"/tmp/test", option.c_str()};
+			p.parseCmdline(2, argv);
+			EXPECT_EQ(p["Values"].get<double>("x"), values[i]);
+		}
+		p.parseIni(filename);
+		EXPECT_EQ(p["Values"].get<double>("x"), values[i]);
+	}
+	std::remove(filename);
+}
+
+TEST(Conversion, NumbersSyntax)
+{
+	int i;
+	EXPECT_TRUE(StringTool<int>::from_string(" 42 ", i));
+	EXPECT_EQ(i, 42);
+	EXPECT_TRUE(StringTool<int>::from_string("+7", i));
+	EXPECT_EQ(i, 7);
+	EXPECT_TRUE(StringTool<int>::from_string("-7", i));
+	EXPECT_EQ(i, -7);
+	EXPECT_FALSE(StringTool<int>::from_string("", i));
+	EXPECT_FALSE(StringTool<int>::from_string("+-7", i));
+	EXPECT_FALSE(StringTool<int>::from_string("4 2", i));
+	EXPECT_FALSE(StringTool<int>::from_string("1.5", i));
+	EXPECT_FALSE(StringTool<int>::from_string("99999999999", i));
+
+	double d;
+	EXPECT_TRUE(StringTool<double>::from_string("1e3", d));
+	EXPECT_EQ(d, 1000.0);
+	EXPECT_TRUE(StringTool<double>::from_string("-.5", d));
+	EXPECT_EQ(d, -0.5);
+	EXPECT_FALSE(StringTool<double>::from_string("1.5x", d));
+	for (const char* nonFinite : {"inf", "-inf", "+inf", "infinity", "INF", "nan", "-nan", "NaN", "nan(1)"})
+		EXPECT_FALSE(StringTool<double>::from_string(nonFinite, d)) << nonFinite;
+	EXPECT_EQ(d, -0.5);
+	float f;
+	EXPECT_FALSE(StringTool<float>::from_string("inf", f));
+	EXPECT_FALSE(StringTool<float>::from_string("nan", f));
+	EXPECT_FALSE(StringTool<float>::from_string("1e39", f));
+
+	bool b;
+	EXPECT_TRUE(StringTool<bool>::from_string(" true", b));
+	EXPECT_TRUE(b);
+	EXPECT_FALSE(StringTool<bool>::from_string("yes", b));
+
+	Parameters p("Parameters", ParametersGroup("Values", Parameter<int>("n", "Value", 0)));
+	const char* argv[] = {"/tmp/test", "--n=12abc"};
+	EXPECT_THROW(p.parseCmdline(2, argv), std::runtime_error);
+}
+
+TEST(Conversion, EnumByNames)
+{
+	Parameters p(
+		"Parameters",
+		ParametersGroup(
+			"Paint",
+			Parameter<Color>("fill", "Fill color", Color::red),
+			Parameter<Color>("border", "Border color", Color::green)
+		)
+	);
+
+	const char* argv[] = {"/tmp/test", "--fill=blue"};
+	p.parseCmdline(2, argv);
+	EXPECT_EQ(p["Paint"].get<Color>("fill"), Color::blue);
+
+	const char filename[] = "test-config-enum.ini";
+	{
+		ofstream f(filename, ios::out);
+		f << "[Paint]\nborder = blue\n";
+	}
+	p.parseIni(filename);
+	EXPECT_EQ(p["Paint"].get<Color>("border"), Color::blue);
+	{
+		ofstream f(filename, ios::out);
+		f << "[Paint]\nborder = purple\n";
+	}
+	EXPECT_THROW(p.parseIni(filename), std::runtime_error);
+	std::remove(filename);
+
+	std::ostringstream ini;
+	p.writeIni(ini);
+	EXPECT_NE(ini.str().find("fill = blue\n"), std::string::npos);
+
+	std::ostringstream help;
+	p.cmdlineHelp(help);
+	EXPECT_NE(help.str().find("arg (=blue)"), std::string::npos);
+}
+
+TEST(Binding, VariablesAndMembers)
+{
+	struct Config
+	{
+		double k = 0;
+		double b = 0;
+		std::string greeter;
+		bool verbose = false;
+	} config;
+	int level = -1;
+
+	Parameters p(
+		"All parameters for your program",
+		ParametersGroup(
+			"Input",
+			Parameter<double>("k", "Value of k", 1.23),
+			Parameter<double>("b", "Value of b", 9.87),
+			Parameter<int>("level", "Level without default").bind(&level)
+		),
+		ParametersGroup(
+			"Interface",
+			Parameter<std::string>("greeter", "String parameter", "Hi, user."),
+			Parameter<bool>("verbose", "Verbose output", ParamterType::cmdLine)
+		)
+	);
+	p["Input"].bindMembers(config, member("k", &Config::k), member("b", &Config::b));
+	p["Interface"].bindMembers(config, member("greeter", &Config::greeter), member("verbose", &Config::verbose));
+
+	// Defaults are written at binding
+	EXPECT_EQ(config.k, 1.23);
+	EXPECT_EQ(config.greeter, "Hi, user.");
+	EXPECT_EQ(level, -1);
+
+	const char filename[] = "test-config-bound.ini";
+	{
+		ofstream f(filename, ios::out);
+		f << "[Input]\nk = 2.5\nlevel = 3\n[Interface]\ngreeter = Hello\n";
+	}
+	p.parseIni(filename);
+	std::remove(filename);
+	EXPECT_EQ(config.k, 2.5);
+	EXPECT_EQ(config.b, 9.87);
+	EXPECT_EQ(level, 3);
+	EXPECT_EQ(config.greeter, "Hello");
+
+	const char* argv[] = {"/tmp/test", "--b=4", "--verbose"};
+	p.parseCmdline(3, argv);
+	EXPECT_EQ(config.b, 4);
+	EXPECT_TRUE(config.verbose);
+
+	EXPECT_THROW(p["Input"].bind("k", &level), std::bad_cast);
+	EXPECT_THROW(p["Input"].bind("missing", &config.k), std::runtime_error);
+}
+
+TEST(Changes, BatchedCallbacks)
+{
+	Parameters p(
+		"All parameters for your program",
+		ParametersGroup(
+			"Input",
+			Parameter<double>("k", "Value of k", 1.23),
+			Parameter<double>("b", "Value of b", 9.87)
+		),
+		ParametersGroup(
+			"Interface",
+			Parameter<std::string>("greeter", "String parameter", "Hi, user.")
+		)
+	);
+
+	int inputCalls = 0, kCalls = 0, interfaceCalls = 0;
+	p.subscribe("Input", [&](const ChangeSet&) { inputCalls++; });
+	size_t kId = p.subscribe("Input", "k", [&](const ChangeSet& changes) {
+		kCalls++;
+		EXPECT_TRUE(changes.contains("Input", "k"));
+	});
+	p.subscribe("Interface", [&](const ChangeSet&) { interfaceCalls++; });
+	EXPECT_THROW(p.subscribe("Input", "missing", [](const ChangeSet&) {}), std::runtime_error);
+
+	const char filename[] = "test-config-changes.ini";
+	struct FileRemover {
+		~FileRemover() { std::remove(filename); }
+		const char* filename;
+	} remover{filename};
+	{
+		ofstream f(filename, ios::out);
+		f << "[Input]\nk = 2\nb = 9.87\n[Interface]\ngreeter = Hi, user.\n";
+	}
+
+	// Only k changed, b is assigned the value it already has and is not reported
+	p.parseIni(filename);
+	EXPECT_EQ(inputCalls, 1);
+	EXPECT_EQ(kCalls, 1);
+	EXPECT_EQ(interfaceCalls, 0);
+	ASSERT_EQ(p.lastChanges().changes().size(), 1);
+	EXPECT_EQ(p.lastChanges().changes()[0].parameter->name(), "k");
+
+	// The same values
+	p.parseIni(filename);
+	EXPECT_EQ(inputCalls, 1);
+	EXPECT_TRUE(p.lastChanges().empty());
+
+	// Value set and reverted by one operation is not a change
+	{
+		ofstream f(filename, ios::out);
+		f << "[Input]\nb = 1\n[Interface]\ngreeter = Hello\n";
+	}
+	const char* argv[] = {"/tmp/test", "--ini-load", filename, "--b=9.87"};
+	PreconfiguredOperations::addGeneralOptions(p);
+	ASSERT_TRUE(PreconfiguredOperations::quickReadConfiguration(p, {}, 4, argv));
+	EXPECT_EQ(inputCalls, 1);
+	EXPECT_EQ(interfaceCalls, 1);
+	EXPECT_TRUE(p.lastChanges().contains("Interface", "greeter"));
+
+	p.unsubscribe(kId);
+	const char* argvK[] = {"/tmp/test", "--k=5"};
+	p.parseCmdline(2, argvK);
+	EXPECT_EQ(inputCalls, 2);
+	EXPECT_EQ(kCalls, 1);
+}
+
+namespace {
+
+uint64_t fakeAllocations = 0;
+
+uint64_t fakeAllocationsCounter()
+{
+	return fakeAllocations += 2;
+}
+
+} // namespace
+
+TEST(Tracing, ChromeTraceExport)
+{
+	const char siteConfig[] = "test-config-traced.ini";
+	struct FileRemover {
+		~FileRemover() { std::remove(filename); }
+		const char* filename;
+	} remover{siteConfig};
+	{
+		ofstream f(siteConfig, ios::out);
+		f << "[Input]\nk = 1\n";
+	}
+
+	Parameters p("Parameters", ParametersGroup("Input", Parameter<int>("k", "Value of k", 0)));
+	PreconfiguredOperations::addGeneralOptions(p);
+	const char* argv[] = {"/tmp/test", "--k=2"};
+
+	// Disabled tracer records nothing
+	Tracer tracer;
+	ASSERT_TRUE(PreconfiguredOperations::quickReadConfiguration(p, {siteConfig}, 2, argv));
+	EXPECT_TRUE(tracer.events().empty());
+
+	tracer.setAllocationsCounter(fakeAllocationsCounter);
+	Tracer::setActive(&tracer);
+	ASSERT_TRUE(PreconfiguredOperations::quickReadConfiguration(p, {siteConfig}, 2, argv));
+	Tracer::setActive(nullptr);
+
+	auto events = tracer.events();
+#ifndef CIC_NO_TRACING
+	auto find = [&events](const std::string& name) -> const Tracer::Event* {
+		for (auto& e : events)
+		{
+			if (e.name == name)
+				return &e;
+		}
+		return nullptr;
+	};
+	ASSERT_NE(find("quickReadConfiguration"), nullptr);
+	ASSERT_NE(find("parse command line"), nullptr);
+	ASSERT_NE(find("merge layers"), nullptr);
+	const Tracer::Event* tokenize = find("tokenize ini");
+	ASSERT_NE(tokenize, nullptr);
+	auto argsText = [](const Tracer::Event& e) {
+		std::string text;
+		for (auto& a : e.args)
+			text += a.first + "=" + a.second + ";";
+		return text;
+	};
+	EXPECT_NE(argsText(*tokenize).find("file=\"test-config-traced.ini\""), std::string::npos);
+	EXPECT_NE(argsText(*tokenize).find("bytes=14;"), std::string::npos);
+	EXPECT_NE(argsText(*tokenize).find("allocations=2"), std::string::npos);
+
+	const Tracer::Event* whole = find("quickReadConfiguration");
+	EXPECT_LE(whole->startNs, tokenize->startNs);
+	EXPECT_GE(whole->startNs + whole->durationNs, tokenize->startNs + tokenize->durationNs);
+
+	std::ostringstream json;
+	tracer.writeChromeTrace(json);
+	EXPECT_EQ(json.str().find("{\"traceEvents\":["), 0);
+	EXPECT_NE(json.str().find("\"name\":\"tokenize ini\",\"cat\":\"cic\",\"ph\":\"X\""), std::string::npos);
+	EXPECT_NE(json.str().find("\"args\":{\"file\":\"test-config-traced.ini\""), std::string::npos);
+#else
+	EXPECT_TRUE(events.empty());
+#endif
+}
+
+TEST(ConcurrentReads, ReadersDuringParse)
+{
+	Parameters p(
+		"Concurrent",
+		ParametersGroup(
+			"Group",
+			Parameter<int>("i", "Int parameter", 0),
+			Parameter<double>("d", "Double parameter", 0.5),
+			Parameter<std::string>("s", "String parameter", "v0")
+		)
+	);
+	p.enableConcurrentReads();
+	Handle<int> i = p.handle<int>("Group", "i");
+	Handle<std::string> s = p.handle<std::string>("Group", "s");
+	const Parameters& cp = p;
+
+	const int writes = 300;
+	std::atomic<bool> stop{false};
+	std::atomic<int> errors{0};
+	std::vector<std::thread> readers;
+	for (int r = 0; r < 4; r++)
+	{
+		readers.emplace_back([&] {
+			int last = 0;
+			while (!stop.load())
+			{
+				// Every value is a whole one and values of one parameter do not go back
+				int value = i.read();
+				double d = cp["Group"].read<double>("d");
+				std::string text = s.read();
+				if (value < last || value > writes || d != std::floor(d) + 0.5 || d > writes + 0.5)
+					errors++;
+				if (text.size() < 2 || text[0] != 'v' || std::stoi(text.substr(1)) > writes)
+					errors++;
+				last = value;
+			}
+		});
+	}
+
+	for (int k = 1; k <= writes; k++)
+	{
+		std::vector<std::string> args{"test", "--Group.i=" + std::to_string(k),
+			"--Group.d=" + std::to_string(k) + ".5", "--Group.s=v" + std::to_string(k)};
+		std::vector<const char*> argv;
+		for (auto& a : args)
+			argv.push_back(a.c_str());
+		p.parseCmdline(argv.size(), argv.data());
+	}
+	stop = true;
+	for (auto& t : readers)
+		t.join();
+
+	EXPECT_EQ(errors.load(), 0);
+	EXPECT_EQ(i.read(), writes);
+	EXPECT_EQ(s.read(), "v" + std::to_string(writes));
+
+	// Group added later also allows concurrent reads, free parameters are read directly
+	p.addGroup(ParametersGroup("Later", Parameter<int>("x", "Not initialized")));
+	EXPECT_THROW(cp["Later"].read<int>("x"), std::runtime_error);
+	Parameter<int> free("free", "Free parameter", 7);
+	EXPECT_EQ(free.read(), 7);
+}